@@ -0,0 +1,453 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <dirent.h>
+
+#include "src/include/game_structures.h"
+#include "src/include/solver_context.h"
+#include "src/include/advanced_solver.h"
+#include "src/include/ida_solver.h"
+#include "src/include/parallel_solver.h"
+#include "src/include/external_solver.h"
+#include "src/include/portfolio_solver.h"
+#include "src/include/board_solver.h"
+#include "src/include/solution_optimizer.h"
+#include "src/include/solver_control.h"
+#include "src/include/deadlock_patterns.h"
+
+// Headless batch solver: solves every level it is given on a pool of
+// threads, one level per thread at a time, and writes the results as JSON
+// and/or CSV. It links no SDL library.
+
+struct BatchOptions {
+    int threads;
+    int searchThreads;
+    int timeLimitMs;
+    size_t memoryMb;
+    bool optimize;
+    bool macros;
+    bool portfolio;
+    bool improve;
+    std::string jsonPath;
+    std::string csvPath;
+    std::string patternPath;
+    std::string externalDir;
+    std::vector<std::string> files;
+    
+    BatchOptions()
+        : threads(0), searchThreads(0), timeLimitMs(10000), memoryMb(512), optimize(true), macros(false), portfolio(false),
+          improve(false) {}
+};
+
+struct BatchResult {
+    std::string file;
+    std::string status;
+    std::string solution;
+    int moves;
+    int pushes;
+    long long nodes;
+    long long ms;
+    size_t peakBytes;
+    
+    BatchResult() : moves(0), pushes(0), nodes(0), ms(0), peakBytes(0) {}
+};
+
+// Orders "level2" before "level10".
+static bool naturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t endA = i, endB = j;
+            while (endA < a.size() && isdigit((unsigned char)a[endA])) endA++;
+            while (endB < b.size() && isdigit((unsigned char)b[endB])) endB++;
+            std::string numberA = a.substr(i, endA - i);
+            std::string numberB = b.substr(j, endB - j);
+            numberA.erase(0, std::min(numberA.find_first_not_of('0'), numberA.size()));
+            numberB.erase(0, std::min(numberB.find_first_not_of('0'), numberB.size()));
+            if (numberA.size() != numberB.size()) return numberA.size() < numberB.size();
+            if (numberA != numberB) return numberA < numberB;
+            i = endA;
+            j = endB;
+        } else {
+            if (a[i] != b[j]) return a[i] < b[j];
+            i++;
+            j++;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// Adds the .txt files of a directory, or the path itself if it is not one.
+static void addLevelPath(const std::string& path, std::vector<std::string>& files) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        files.push_back(path);
+        return;
+    }
+    
+    std::vector<std::string> found;
+    for (struct dirent* entry; (entry = readdir(dir));) {
+        std::string file = entry->d_name;
+        if (file.size() > 4 && file.substr(file.size() - 4) == ".txt") {
+            found.push_back(path + "/" + file);
+        }
+    }
+    closedir(dir);
+    
+    std::sort(found.begin(), found.end(), naturalLess);
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+// Guards deadlockPatternStore, which every worker thread reads and adds to.
+static std::mutex patternMutex;
+
+// The push-optimal A* (with --macros, the macro-move A*; with --parallel,
+// the hash-distributed A*) within the level's budgets, then IDA* for
+// whatever time is left if A* ran out of memory, or with --external the
+// breadth-first search that keeps its states on disk. `pushOptimal` tells
+// whether the solution has the fewest pushes.
+static std::string solveWithEngines(const Level& level, const SolverContext& context, DeadlockPatterns* usePatterns,
+                                    const BatchOptions& options, long long startTime, BatchResult& result,
+                                    bool& pushOptimal) {
+    std::string solution;
+    bool limitReached;
+    if (options.searchThreads > 0) {
+        ParallelSolver solver(options.searchThreads);
+        solver.setContext(context);
+        solver.setPatterns(usePatterns);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, level.playerStartX, level.playerStartY);
+        pushOptimal = true;
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+        result.status = solver.isTimedOut() ? "timeout" : solver.isLimitReached() ? "memory" : "unsolvable";
+        limitReached = solver.isLimitReached();
+    } else {
+        AdvancedSolver solver;
+        solver.setContext(context);
+        solver.setPatterns(usePatterns);
+        solver.setMacroMoves(options.macros);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, level.playerStartX, level.playerStartY);
+        pushOptimal = !options.macros;
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+        result.status = solver.isTimedOut() ? "timeout" : solver.isLimitReached() ? "memory" : "unsolvable";
+        limitReached = solver.isLimitReached();
+    }
+    
+    int remainingMs = options.timeLimitMs - (int)(solverClockMs() - startTime);
+    if (solution.empty() && limitReached && remainingMs > 0 && !options.externalDir.empty()) {
+        ExternalSolver externalSolver;
+        externalSolver.setContext(context);
+        externalSolver.setPatterns(usePatterns);
+        externalSolver.setWorkDir(options.externalDir);
+        externalSolver.setMemoryBudgetMb(std::max<size_t>(1, options.memoryMb / 4));
+        externalSolver.setTimeLimitMs(remainingMs);
+        solution = externalSolver.solve(level, level.playerStartX, level.playerStartY);
+        pushOptimal = true;
+        result.nodes += externalSolver.getNodesExplored();
+        result.peakBytes = std::max(result.peakBytes, externalSolver.getMemoryBytes());
+        result.status = externalSolver.wasAborted() ? "timeout" : "unsolvable";
+    } else if (solution.empty() && limitReached && remainingMs > 0) {
+        IdaSolver idaSolver(std::max<size_t>(1, options.memoryMb / 4));
+        idaSolver.setContext(context);
+        idaSolver.setPatterns(usePatterns);
+        idaSolver.setTimeLimitMs(remainingMs);
+        solution = idaSolver.solve(level, level.playerStartX, level.playerStartY);
+        pushOptimal = true;
+        result.nodes += idaSolver.getNodesExplored();
+        result.peakBytes = std::max(result.peakBytes, idaSolver.getPeakBytes());
+        result.status = idaSolver.wasAborted() ? "timeout" : "unsolvable";
+    }
+    
+    return solution;
+}
+
+// The board-indexed search, for levels with more floor than SolverContext
+// indexes. Patterns, the optimizer and the fallback engines all need the
+// context, so none of them run.
+static std::string solveOnBoard(const Level& level, const BatchOptions& options, BatchResult& result) {
+    BoardSolver solver;
+    solver.setTimeLimitMs(options.timeLimitMs);
+    solver.setMemoryBudgetMb(options.memoryMb);
+    std::string solution = solver.solve(level, level.playerStartX, level.playerStartY);
+    result.nodes = solver.getNodesExplored();
+    result.peakBytes = solver.getPeakBytes();
+    result.status = solver.isTimedOut() ? "timeout" : solver.isLimitReached() ? "memory" : "unsolvable";
+    return solution;
+}
+
+// Replays a found solution from the start and records it, or marks the
+// result invalid if it does not solve the level.
+static void recordSolution(const Level& level, const std::string& solution, BatchResult& result) {
+    if (solution.empty()) {
+        return;
+    }
+    if (replaySolution(level, level.playerStartX, level.playerStartY, solution, result.pushes)) {
+        result.status = "solved";
+        result.solution = solution;
+        result.moves = solution.size();
+    } else {
+        result.status = "invalid";
+    }
+}
+
+// Solves one level file with the engines above, or with --portfolio by
+// racing them, then optimizes and checks the solution; the optimizer keeps
+// the pushes of a push-optimal solution. With --patterns, the level's
+// stored deadlock patterns prune the searches, and what A* learns is kept
+// for next time.
+static BatchResult solveFile(const std::string& file, const BatchOptions& options) {
+    BatchResult result;
+    result.file = file;
+    long long startTime = solverClockMs();
+    
+    Level level;
+    if (!loadLevelFromFile(file.c_str(), &level)) {
+        result.status = "load_error";
+        return result;
+    }
+    SolverContext context;
+    if (!context.build(level, level.playerStartX, level.playerStartY)) {
+        if (countFloorCells(level, level.playerStartX, level.playerStartY) > MAX_FLOOR_CELLS) {
+            recordSolution(level, solveOnBoard(level, options, result), result);
+        } else {
+            result.status = "unsupported";
+        }
+        result.ms = solverClockMs() - startTime;
+        return result;
+    }
+    
+    DeadlockPatterns patterns;
+    DeadlockPatterns* usePatterns = options.patternPath.empty() ? nullptr : &patterns;
+    if (usePatterns) {
+        std::lock_guard<std::mutex> lock(patternMutex);
+        deadlockPatternStore.fill(level, level.playerStartX, level.playerStartY, context, patterns);
+    }
+    
+    std::string solution;
+    bool pushOptimal = false;
+    if (options.portfolio) {
+        PortfolioSolver portfolio;
+        portfolio.setContext(context);
+        portfolio.setPatterns(usePatterns);
+        portfolio.setImprove(options.improve);
+        portfolio.setTimeLimitMs(options.timeLimitMs);
+        portfolio.setMemoryBudgetMb(options.memoryMb);
+        solution = portfolio.solve(level, level.playerStartX, level.playerStartY);
+        pushOptimal = portfolio.isWinnerPushOptimal();
+        result.nodes = portfolio.getNodesExplored();
+        result.peakBytes = portfolio.getPeakBytes();
+        result.status = portfolio.isTimedOut() ? "timeout" : portfolio.isLimitReached() ? "memory" : "unsolvable";
+    } else {
+        solution = solveWithEngines(level, context, usePatterns, options, startTime, result, pushOptimal);
+    }
+    
+    if (usePatterns) {
+        std::lock_guard<std::mutex> lock(patternMutex);
+        deadlockPatternStore.merge(level, level.playerStartX, level.playerStartY, context, patterns);
+    }
+    
+    if (!solution.empty() && options.optimize) {
+        SolutionOptimizer optimizer;
+        optimizer.setObjective(pushOptimal ? OPTIMIZE_PUSHES : OPTIMIZE_MOVES);
+        solution = optimizer.optimize(context, level, level.playerStartX, level.playerStartY, solution);
+    }
+    recordSolution(level, solution, result);
+    
+    result.ms = solverClockMs() - startTime;
+    return result;
+}
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static bool writeJson(const std::string& path, const std::vector<BatchResult>& results) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& r = results[i];
+        file << "  {\"file\": \"" << jsonEscape(r.file) << "\", \"status\": \"" << r.status
+             << "\", \"solution\": \"" << r.solution << "\", \"moves\": " << r.moves
+             << ", \"pushes\": " << r.pushes << ", \"nodes\": " << r.nodes << ", \"ms\": " << r.ms
+             << ", \"peak_bytes\": " << r.peakBytes << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "]\n";
+    return true;
+}
+
+static bool writeCsv(const std::string& path, const std::vector<BatchResult>& results) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << "file,status,solution,moves,pushes,nodes,ms,peak_bytes\n";
+    for (const BatchResult& r : results) {
+        std::string quoted = r.file;
+        size_t quote = 0;
+        while ((quote = quoted.find('"', quote)) != std::string::npos) {
+            quoted.insert(quote, 1, '"');
+            quote += 2;
+        }
+        file << "\"" << quoted << "\"," << r.status << "," << r.solution << "," << r.moves << ","
+             << r.pushes << "," << r.nodes << "," << r.ms << "," << r.peakBytes << "\n";
+    }
+    return true;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <level file or directory>...\n"
+              << "  --threads N      levels solved at once (default: one per core, or per\n"
+              << "                   four cores with --portfolio, or per N with --parallel N)\n"
+              << "  --parallel N     search each level with the hash-distributed A* on N threads\n"
+              << "  --time-ms N      time budget per level (default 10000)\n"
+              << "  --memory-mb N    memory budget per level (default 512)\n"
+              << "  --json FILE      write results as JSON\n"
+              << "  --csv FILE       write results as CSV\n"
+              << "  --patterns FILE  deadlock patterns to start from and add to\n"
+              << "  --external DIR   when A* runs out of memory, search on with states kept in DIR\n"
+              << "  --portfolio      race several engines per level; the first solution wins\n"
+              << "  --improve        with --portfolio, let the push-optimal engines beat a first solution\n"
+              << "  --macros         push through tunnels and goal rooms as one move (not push-optimal)\n"
+              << "  --no-optimize    keep solutions as the search found them" << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "--parallel" && hasValue) {
+            options.searchThreads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--time-ms" && hasValue) {
+            options.timeLimitMs = atoi(argv[++i]);
+        } else if (arg == "--memory-mb" && hasValue) {
+            options.memoryMb = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--csv" && hasValue) {
+            options.csvPath = argv[++i];
+        } else if (arg == "--patterns" && hasValue) {
+            options.patternPath = argv[++i];
+        } else if (arg == "--external" && hasValue) {
+            options.externalDir = argv[++i];
+        } else if (arg == "--portfolio") {
+            options.portfolio = true;
+        } else if (arg == "--improve") {
+            options.improve = true;
+        } else if (arg == "--macros") {
+            options.macros = true;
+        } else if (arg == "--no-optimize") {
+            options.optimize = false;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        } else {
+            addLevelPath(arg, options.files);
+        }
+    }
+    return !options.files.empty();
+}
+
+int main(int argc, char* argv[]) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    
+    int threadCount = options.threads;
+    if (threadCount <= 0) {
+        // A portfolio already runs one thread per engine, a parallel search
+        // one per worker.
+        int perLevel = options.portfolio ? PortfolioSolver::STRATEGY_COUNT : std::max(1, options.searchThreads);
+        threadCount = (int)std::thread::hardware_concurrency() / perLevel;
+    }
+    threadCount = std::max(1, std::min(threadCount, (int)options.files.size()));
+    
+    // Patterns of levels outside this run are kept as they are.
+    if (!options.patternPath.empty()) {
+        deadlockPatternStore.load(options.patternPath.c_str(), std::vector<std::string>());
+    }
+    
+    std::vector<BatchResult> results(options.files.size());
+    std::atomic<size_t> nextFile(0);
+    std::mutex printMutex;
+    
+    auto work = [&]() {
+        for (size_t i = nextFile++; i < options.files.size(); i = nextFile++) {
+            results[i] = solveFile(options.files[i], options);
+            
+            std::lock_guard<std::mutex> lock(printMutex);
+            const BatchResult& r = results[i];
+            std::cout << r.file << ": " << r.status << ", " << r.moves << " moves, " << r.pushes
+                      << " pushes, " << r.nodes << " nodes, " << r.ms << " ms, "
+                      << r.peakBytes / 1024 << " KB" << std::endl;
+        }
+    };
+    
+    long long startTime = solverClockMs();
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threadCount; i++) {
+        pool.emplace_back(work);
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    
+    int solved = 0;
+    for (const BatchResult& r : results) {
+        solved += r.status == "solved";
+    }
+    std::cout << "Solved " << solved << "/" << results.size() << " levels in "
+              << solverClockMs() - startTime << " ms on " << threadCount << " threads" << std::endl;
+    
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results)) {
+        std::cerr << "Failed to write " << options.jsonPath << std::endl;
+    }
+    if (!options.csvPath.empty() && !writeCsv(options.csvPath, results)) {
+        std::cerr << "Failed to write " << options.csvPath << std::endl;
+    }
+    if (!options.patternPath.empty()) {
+        if (deadlockPatternStore.save(options.patternPath.c_str())) {
+            std::cout << deadlockPatternStore.size() << " deadlock patterns in " << options.patternPath << std::endl;
+        } else {
+            std::cerr << "Failed to write " << options.patternPath << std::endl;
+        }
+    }
+    
+    return solved == (int)results.size() ? 0 : 1;
+}
@@ -0,0 +1,669 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <dirent.h>
+
+#include "src/include/game_structures.h"
+#include "src/include/solver_context.h"
+#include "src/include/advanced_solver.h"
+#include "src/include/ida_solver.h"
+#include "src/include/parallel_solver.h"
+#include "src/include/bidirectional_solver.h"
+#include "src/include/portfolio_solver.h"
+#include "src/include/solver_control.h"
+
+// Solver benchmark: runs a fixed corpus (levels/ and the synthetic levels in
+// bench/levels/) through every solver configuration, then compares nodes,
+// nodes per second, peak memory and wall time with a stored baseline.
+// Solved levels, nodes and peak memory regressing past their thresholds
+// make the run fail. Wall time and nodes per second depend on the machine
+// and its load, so they are only reported, and flagged past theirs.
+//
+// A* and IDA* stop on a node limit rather than a clock, so which levels
+// get solved does not depend on the machine.
+
+struct BenchOptions {
+    std::string baselinePath;
+    bool update;
+    bool verbose;
+    int timeLimitMs;
+    int nodeLimit;
+    size_t memoryMb;
+    double nodeThreshold;
+    double timeThreshold;
+    double memoryThreshold;
+    std::string configFilter;
+    std::string generateDir;
+    std::vector<std::string> paths;
+    
+    BenchOptions()
+        : baselinePath("bench/baseline.txt"), update(false), verbose(false), timeLimitMs(5000), nodeLimit(1000000),
+          memoryMb(256),
+          nodeThreshold(0.05), timeThreshold(0.30), memoryThreshold(0.10) {}
+};
+
+struct BenchConfig {
+    const char* name;
+    bool deterministic;     // same node counts on every run
+};
+
+static const BenchConfig CONFIGS[] = {
+    {"astar", true},
+    {"astar-macros", true},
+    {"astar-steps", true},
+    {"ida", true},
+    {"parallel2", false},
+    {"bidirectional", true},
+    {"portfolio", false},
+};
+
+struct RunResult {
+    bool solved;
+    bool valid;
+    long long nodes;
+    long long ms;
+    size_t peakBytes;
+    
+    RunResult() : solved(false), valid(true), nodes(0), ms(0), peakBytes(0) {}
+};
+
+// Totals for one configuration over the corpus. Nodes and peak memory come
+// from the solved levels only, since a timed-out search gets as far as the
+// machine manages in the time allowed.
+struct ConfigTotals {
+    long long levels;
+    long long solved;
+    long long invalid;
+    long long nodes;
+    long long ms;
+    long long allNodes;
+    size_t peakBytes;
+    
+    ConfigTotals() : levels(0), solved(0), invalid(0), nodes(0), ms(0), allNodes(0), peakBytes(0) {}
+    
+    long long nodesPerSecond() const { return ms > 0 ? allNodes * 1000 / ms : 0; }
+};
+
+static RunResult runConfig(const std::string& name, const Level& level, const SolverContext& context,
+                           const BenchOptions& options) {
+    RunResult result;
+    std::string solution;
+    long long startTime = solverClockMs();
+    int px = level.playerStartX;
+    int py = level.playerStartY;
+    
+    if (name == "astar" || name == "astar-macros" || name == "astar-steps") {
+        AdvancedSolver solver(name == "astar-steps" ? SOLVER_MODE_STEPS : SOLVER_MODE_PUSHES);
+        solver.setContext(context);
+        solver.setMacroMoves(name == "astar-macros");
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setNodeLimit(options.nodeLimit);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, px, py);
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+    } else if (name == "ida") {
+        IdaSolver solver(std::max<size_t>(1, options.memoryMb / 4));
+        solver.setContext(context);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setNodeLimit(options.nodeLimit);
+        solution = solver.solve(level, px, py);
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+    } else if (name == "parallel2") {
+        ParallelSolver solver(2);
+        solver.setContext(context);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setNodeLimit(options.nodeLimit);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, px, py);
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+    } else if (name == "bidirectional") {
+        BidirectionalSolver solver;
+        solver.setContext(context);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setNodeLimit(options.nodeLimit);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, px, py);
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+    } else if (name == "portfolio") {
+        PortfolioSolver solver;
+        solver.setContext(context);
+        solver.setTimeLimitMs(options.timeLimitMs);
+        solver.setMemoryBudgetMb(options.memoryMb);
+        solution = solver.solve(level, px, py);
+        result.nodes = solver.getNodesExplored();
+        result.peakBytes = solver.getPeakBytes();
+    }
+    
+    result.ms = solverClockMs() - startTime;
+    if (!solution.empty()) {
+        int pushes;
+        result.solved = true;
+        result.valid = replaySolution(level, px, py, solution, pushes);
+    }
+    return result;
+}
+
+// Orders "level2" before "level10".
+static bool naturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t endA = i, endB = j;
+            while (endA < a.size() && isdigit((unsigned char)a[endA])) endA++;
+            while (endB < b.size() && isdigit((unsigned char)b[endB])) endB++;
+            std::string numberA = a.substr(i, endA - i);
+            std::string numberB = b.substr(j, endB - j);
+            numberA.erase(0, std::min(numberA.find_first_not_of('0'), numberA.size()));
+            numberB.erase(0, std::min(numberB.find_first_not_of('0'), numberB.size()));
+            if (numberA.size() != numberB.size()) return numberA.size() < numberB.size();
+            if (numberA != numberB) return numberA < numberB;
+            i = endA;
+            j = endB;
+        } else {
+            if (a[i] != b[j]) return a[i] < b[j];
+            i++;
+            j++;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// Adds the .txt files of a directory, or the path itself if it is not one.
+static void addLevelPath(const std::string& path, std::vector<std::string>& files) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        files.push_back(path);
+        return;
+    }
+    
+    std::vector<std::string> found;
+    for (struct dirent* entry; (entry = readdir(dir));) {
+        std::string file = entry->d_name;
+        if (file.size() > 4 && file.substr(file.size() - 4) == ".txt") {
+            found.push_back(path + "/" + file);
+        }
+    }
+    closedir(dir);
+    
+    std::sort(found.begin(), found.end(), naturalLess);
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+// Small fixed generator so the synthetic levels come out the same on every
+// platform.
+class BenchRandom {
+public:
+    explicit BenchRandom(uint32_t seed) : state(seed * 2654435761u + 1) {}
+    
+    int below(int bound) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % bound;
+    }
+
+private:
+    uint32_t state;
+};
+
+struct SyntheticSpec {
+    uint32_t seed;
+    int width;
+    int height;
+    int boxes;
+    int pulls;
+};
+
+static const int GENERATOR_ATTEMPTS = 64;
+
+// The synthetic part of the corpus. Changing this list changes the
+// benchmark, so the baseline has to be written again after it.
+static const SyntheticSpec SYNTHETIC_LEVELS[] = {
+    {233, 10, 10, 8, 320},
+    {345, 12, 10, 10, 400},
+    {405, 12, 11, 12, 480},
+    {338, 12, 10, 10, 400},
+    {475, 14, 11, 14, 560},
+    {352, 12, 10, 10, 400},
+    {461, 14, 11, 14, 560},
+    {440, 13, 11, 13, 520},
+    {324, 12, 10, 10, 400},
+    {496, 14, 11, 14, 560},
+    {482, 14, 11, 14, 560},
+};
+
+// Builds a level by playing backwards: boxes start on their targets and the
+// player pulls them around at random, so the result is always solvable.
+// Interior walls are sprinkled in first, keeping the floor connected.
+static std::vector<std::string> generateLevel(const SyntheticSpec& spec) {
+    BenchRandom random(spec.seed);
+    int width = spec.width;
+    int height = spec.height;
+    std::vector<std::string> grid(height, std::string(width, ' '));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+                grid[y][x] = '#';
+            }
+        }
+    }
+    
+    const int dx[4] = {0, 1, 0, -1};
+    const int dy[4] = {-1, 0, 1, 0};
+    auto floorCells = [&](const std::vector<std::vector<int>>& boxes, int from, std::vector<char>& seen) {
+        seen.assign(width * height, 0);
+        std::vector<int> stack(1, from);
+        seen[from] = 1;
+        int count = 1;
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            for (int dir = 0; dir < 4; dir++) {
+                int nx = cell % width + dx[dir];
+                int ny = cell / width + dy[dir];
+                int next = ny * width + nx;
+                if (grid[ny][nx] != '#' && !boxes[ny][nx] && !seen[next]) {
+                    seen[next] = 1;
+                    stack.push_back(next);
+                    count++;
+                }
+            }
+        }
+        return count;
+    };
+    
+    std::vector<std::vector<int>> boxes(height, std::vector<int>(width, 0));
+    std::vector<char> seen;
+    int openCells = (width - 2) * (height - 2);
+    for (int attempt = 0; attempt < openCells / 3; attempt++) {
+        int x = 1 + random.below(width - 2);
+        int y = 1 + random.below(height - 2);
+        if (grid[y][x] == '#') {
+            continue;
+        }
+        grid[y][x] = '#';
+        int start = (y == 1 ? 2 : 1) * width + (x == 1 ? 2 : 1);
+        if (grid[start / width][start % width] == '#' || floorCells(boxes, start, seen) != openCells - 1) {
+            grid[y][x] = ' ';
+        } else {
+            openCells--;
+        }
+    }
+    
+    std::vector<int> freeCells;
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 1; x < width - 1; x++) {
+            if (grid[y][x] != '#') {
+                freeCells.push_back(y * width + x);
+            }
+        }
+    }
+    for (int i = 0; i < spec.boxes; i++) {
+        std::swap(freeCells[i], freeCells[i + random.below(freeCells.size() - i)]);
+        grid[freeCells[i] / width][freeCells[i] % width] = '.';
+    }
+    
+    // Random pulls mostly undo each other, so several tries are played and
+    // the one that leaves the boxes farthest from their own targets is kept.
+    std::vector<std::vector<int>> bestBoxes;
+    int bestPlayer = -1;
+    int bestSpread = -1;
+    for (int attempt = 0; attempt < GENERATOR_ATTEMPTS; attempt++) {
+        for (std::vector<int>& row : boxes) {
+            std::fill(row.begin(), row.end(), 0);
+        }
+        for (int i = 0; i < spec.boxes; i++) {
+            boxes[freeCells[i] / width][freeCells[i] % width] = i + 1;
+        }
+        int player = freeCells[spec.boxes + random.below(freeCells.size() - spec.boxes)];
+        
+        for (int pull = 0; pull < spec.pulls; pull++) {
+            // A pull moves a box one step towards the player, who steps back.
+            floorCells(boxes, player, seen);
+            std::vector<std::pair<int, int>> pulls;
+            for (int y = 1; y < height - 1; y++) {
+                for (int x = 1; x < width - 1; x++) {
+                    if (!boxes[y][x]) {
+                        continue;
+                    }
+                    for (int dir = 0; dir < 4; dir++) {
+                        int sx = x + dx[dir], sy = y + dy[dir];
+                        int bx = sx + dx[dir], by = sy + dy[dir];
+                        if (seen[sy * width + sx] && grid[by][bx] != '#' && !boxes[by][bx]) {
+                            pulls.push_back(std::make_pair(y * width + x, dir));
+                        }
+                    }
+                }
+            }
+            if (pulls.empty()) {
+                break;
+            }
+            
+            std::pair<int, int> chosen = pulls[random.below(pulls.size())];
+            int x = chosen.first % width, y = chosen.first / width;
+            int dir = chosen.second;
+            boxes[y + dy[dir]][x + dx[dir]] = boxes[y][x];
+            boxes[y][x] = 0;
+            player = (y + 2 * dy[dir]) * width + x + 2 * dx[dir];
+            
+            // Let the player wander off before the next pull.
+            floorCells(boxes, player, seen);
+            std::vector<int> reachable;
+            for (int cell = 0; cell < width * height; cell++) {
+                if (seen[cell]) {
+                    reachable.push_back(cell);
+                }
+            }
+            player = reachable[random.below(reachable.size())];
+        }
+        
+        int spread = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (boxes[y][x]) {
+                    int target = freeCells[boxes[y][x] - 1];
+                    spread += abs(target % width - x) + abs(target / width - y);
+                }
+            }
+        }
+        if (spread > bestSpread) {
+            bestSpread = spread;
+            bestBoxes = boxes;
+            bestPlayer = player;
+        }
+    }
+    
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (bestBoxes[y][x]) {
+                grid[y][x] = grid[y][x] == '.' ? '*' : '$';
+            }
+        }
+    }
+    char& playerTile = grid[bestPlayer / width][bestPlayer % width];
+    playerTile = playerTile == '.' ? '+' : '@';
+    return grid;
+}
+
+static bool writeSyntheticLevels(const std::string& dir) {
+    int index = 1;
+    for (const SyntheticSpec& spec : SYNTHETIC_LEVELS) {
+        char name[32];
+        snprintf(name, sizeof(name), "/synthetic%02d.txt", index++);
+        std::ofstream file(dir + name);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write " << dir << name << std::endl;
+            return false;
+        }
+        for (const std::string& row : generateLevel(spec)) {
+            file << row << "\n";
+        }
+    }
+    std::cout << "Wrote " << index - 1 << " synthetic levels to " << dir << std::endl;
+    return true;
+}
+
+typedef std::map<std::string, std::map<std::string, long long>> Baseline;
+
+static bool loadBaseline(const std::string& path, Baseline& baseline) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string config, metric;
+        long long value;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (ss >> config >> metric >> value) {
+            baseline[config][metric] = value;
+        }
+    }
+    return true;
+}
+
+static bool saveBaseline(const std::string& path, const std::map<std::string, ConfigTotals>& totals,
+                         const BenchOptions& options) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "# Written by bench_solver --update with --node-limit " << options.nodeLimit << " --time-ms "
+         << options.timeLimitMs << " --memory-mb " << options.memoryMb << "\n"
+         << "# config metric value\n";
+    for (const auto& entry : totals) {
+        const ConfigTotals& t = entry.second;
+        file << entry.first << " levels " << t.levels << "\n"
+             << entry.first << " solved " << t.solved << "\n"
+             << entry.first << " nodes " << t.nodes << "\n"
+             << entry.first << " nodes_per_sec " << t.nodesPerSecond() << "\n"
+             << entry.first << " peak_bytes " << t.peakBytes << "\n"
+             << entry.first << " ms " << t.ms << "\n";
+    }
+    return true;
+}
+
+// Prints one metric against the baseline. `higherIsWorse` tells which way
+// a change counts as a regression; false when it went past `threshold`.
+// A metric that is not `checked` is flagged past it but never fails.
+static bool checkMetric(const std::string& config, const char* metric, long long value,
+                        const std::map<std::string, long long>& stored, double threshold, bool higherIsWorse,
+                        bool checked = true) {
+    auto found = stored.find(metric);
+    if (found == stored.end()) {
+        std::cout << "  " << std::left << std::setw(14) << metric << value << " (no baseline)" << std::endl;
+        return true;
+    }
+    
+    long long base = found->second;
+    double change = base != 0 ? (double)(value - base) / base : (value != 0 ? 1.0 : 0.0);
+    double worse = higherIsWorse ? change : -change;
+    bool ok = worse <= threshold;
+    std::cout << "  " << std::left << std::setw(14) << metric << std::setw(14) << value << "baseline "
+              << std::setw(14) << base << std::showpos << std::fixed << std::setprecision(1) << change * 100
+              << "%" << std::noshowpos << (ok ? "" : checked ? "  REGRESSION" : "  slower, not checked") << std::endl;
+    if (!ok && checked) {
+        std::cerr << config << ": " << metric << " regressed from " << base << " to " << value << std::endl;
+    }
+    return ok || !checked;
+}
+
+static bool compareWithBaseline(const std::map<std::string, ConfigTotals>& totals, const Baseline& baseline,
+                                const BenchOptions& options) {
+    bool passed = true;
+    for (const auto& entry : totals) {
+        const std::string& config = entry.first;
+        const ConfigTotals& t = entry.second;
+        std::cout << config << ":" << std::endl;
+        
+        auto stored = baseline.find(config);
+        if (stored == baseline.end()) {
+            std::cout << "  no baseline for this configuration" << std::endl;
+            continue;
+        }
+        auto levels = stored->second.find("levels");
+        if (levels != stored->second.end() && levels->second != t.levels) {
+            std::cerr << config << ": the corpus has " << t.levels << " levels, the baseline "
+                      << levels->second << "; run with --update" << std::endl;
+            passed = false;
+            continue;
+        }
+        
+        bool deterministic = false;
+        for (const BenchConfig& known : CONFIGS) {
+            deterministic |= config == known.name && known.deterministic;
+        }
+        
+        passed &= checkMetric(config, "solved", t.solved, stored->second, 0.0, false);
+        if (deterministic) {
+            passed &= checkMetric(config, "nodes", t.nodes, stored->second, options.nodeThreshold, true);
+        }
+        passed &= checkMetric(config, "peak_bytes", t.peakBytes, stored->second, options.memoryThreshold, true);
+        checkMetric(config, "nodes_per_sec", t.nodesPerSecond(), stored->second, options.timeThreshold, false, false);
+        checkMetric(config, "ms", t.ms, stored->second, options.timeThreshold, true, false);
+    }
+    return passed;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [level file or directory]...\n"
+              << "  --baseline FILE        baseline to compare with (default bench/baseline.txt)\n"
+              << "  --update               write the baseline from this run instead\n"
+              << "  --configs A,B          run only these of: astar, astar-macros, astar-steps, ida, parallel2,\n"
+              << "                         bidirectional, portfolio\n"
+              << "  --node-limit N         expansions per level for every search but the portfolio (default 1000000)\n"
+              << "  --time-ms N            time budget per level and configuration (default 5000)\n"
+              << "  --memory-mb N          memory budget per level (default 256)\n"
+              << "  --node-threshold PCT   allowed rise in nodes (default 5)\n"
+              << "  --time-threshold PCT   rise in time or drop in nodes/sec that is flagged; timings never\n"
+              << "                         fail the run (default 30)\n"
+              << "  --memory-threshold PCT allowed rise in peak memory (default 10)\n"
+              << "  --generate DIR         write the synthetic levels to DIR and exit\n"
+              << "  --verbose              print every level\n"
+              << "The corpus defaults to levels/ and bench/levels/." << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if (arg == "--baseline" && hasValue) {
+            options.baselinePath = argv[++i];
+        } else if (arg == "--update") {
+            options.update = true;
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg == "--configs" && hasValue) {
+            options.configFilter = "," + std::string(argv[++i]) + ",";
+        } else if (arg == "--time-ms" && hasValue) {
+            options.timeLimitMs = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--node-limit" && hasValue) {
+            options.nodeLimit = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--memory-mb" && hasValue) {
+            options.memoryMb = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--node-threshold" && hasValue) {
+            options.nodeThreshold = atof(argv[++i]) / 100;
+        } else if (arg == "--time-threshold" && hasValue) {
+            options.timeThreshold = atof(argv[++i]) / 100;
+        } else if (arg == "--memory-threshold" && hasValue) {
+            options.memoryThreshold = atof(argv[++i]) / 100;
+        } else if (arg == "--generate" && hasValue) {
+            options.generateDir = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        } else {
+            options.paths.push_back(arg);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (!options.generateDir.empty()) {
+        return writeSyntheticLevels(options.generateDir) ? 0 : 1;
+    }
+    
+    if (options.paths.empty()) {
+        options.paths.push_back("levels");
+        options.paths.push_back("bench/levels");
+    }
+    std::vector<std::string> files;
+    for (const std::string& path : options.paths) {
+        addLevelPath(path, files);
+    }
+    
+    std::map<std::string, ConfigTotals> totals;
+    for (const BenchConfig& config : CONFIGS) {
+        if (options.configFilter.empty() || options.configFilter.find("," + std::string(config.name) + ",") != std::string::npos) {
+            totals[config.name] = ConfigTotals();
+        }
+    }
+    if (totals.empty()) {
+        std::cerr << "No known configuration in --configs" << std::endl;
+        return 2;
+    }
+    
+    bool loadFailed = false;
+    for (const std::string& file : files) {
+        Level level;
+        SolverContext context;
+        if (!loadLevelFromFile(file.c_str(), &level) || !context.build(level, level.playerStartX, level.playerStartY)) {
+            std::cerr << "Cannot load or prepare " << file << std::endl;
+            loadFailed = true;
+            continue;
+        }
+        
+        for (auto& entry : totals) {
+            RunResult run = runConfig(entry.first, level, context, options);
+            ConfigTotals& t = entry.second;
+            t.levels++;
+            t.solved += run.solved && run.valid;
+            t.invalid += run.solved && !run.valid;
+            t.nodes += run.solved ? run.nodes : 0;
+            t.allNodes += run.nodes;
+            t.ms += run.ms;
+            t.peakBytes = std::max(t.peakBytes, run.solved ? run.peakBytes : 0);
+            
+            if (options.verbose || (run.solved && !run.valid)) {
+                std::cout << file << " " << entry.first << ": "
+                          << (!run.solved ? "unsolved" : run.valid ? "solved" : "INVALID") << ", " << run.nodes
+                          << " nodes, " << run.ms << " ms, " << run.peakBytes / 1024 << " KB" << std::endl;
+            }
+        }
+    }
+    
+    bool invalid = false;
+    for (const auto& entry : totals) {
+        if (entry.second.invalid > 0) {
+            std::cerr << entry.first << ": " << entry.second.invalid << " solutions do not replay" << std::endl;
+            invalid = true;
+        }
+    }
+    
+    if (options.update) {
+        if (!saveBaseline(options.baselinePath, totals, options)) {
+            std::cerr << "Failed to write " << options.baselinePath << std::endl;
+            return 1;
+        }
+        std::cout << "Baseline written to " << options.baselinePath << std::endl;
+        for (const auto& entry : totals) {
+            const ConfigTotals& t = entry.second;
+            std::cout << entry.first << ": " << t.solved << "/" << t.levels << " solved, " << t.nodes << " nodes, "
+                      << t.nodesPerSecond() << " nodes/s, " << t.peakBytes / 1024 << " KB peak, " << t.ms << " ms"
+                      << std::endl;
+        }
+        return invalid || loadFailed ? 1 : 0;
+    }
+    
+    Baseline baseline;
+    if (!loadBaseline(options.baselinePath, baseline)) {
+        std::cerr << "Cannot read " << options.baselinePath << "; run with --update to create it" << std::endl;
+        return 1;
+    }
+    bool passed = compareWithBaseline(totals, baseline, options);
+    std::cout << (passed && !invalid && !loadFailed ? "Benchmark passed" : "Benchmark FAILED") << std::endl;
+    return passed && !invalid && !loadFailed ? 0 : 1;
+}
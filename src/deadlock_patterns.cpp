@@ -0,0 +1,152 @@
+#include "include/deadlock_patterns.h"
+#include "include/solution_cache.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_set>
+#include <algorithm>
+
+DeadlockPatternStore deadlockPatternStore;
+const char* DEADLOCK_PATTERN_FILE = "deadlocks.dat";
+
+namespace {
+
+std::vector<int> boardCells(const BoxSet& cells, const SolverContext& context) {
+    std::vector<int> board;
+    for (int cell = cells.next(0); cell >= 0; cell = cells.next(cell + 1)) {
+        board.push_back(context.cellPos[cell].y * context.width + context.cellPos[cell].x);
+    }
+    return board;
+}
+
+// False if a board cell is not on the context's floor.
+bool floorCells(const std::vector<int>& board, const SolverContext& context, BoxSet& cells) {
+    cells.clear();
+    for (int index : board) {
+        int cell = context.cellOf(index % context.width, index / context.width);
+        if (cell < 0) {
+            return false;
+        }
+        cells.set(cell);
+    }
+    return true;
+}
+
+void writeCells(std::ostream& out, const std::vector<int>& cells) {
+    for (size_t i = 0; i < cells.size(); i++) {
+        out << (i > 0 ? "," : "") << cells[i];
+    }
+}
+
+bool readCells(const std::string& text, std::vector<int>& cells) {
+    std::stringstream ss(text);
+    std::string item;
+    cells.clear();
+    while (std::getline(ss, item, ',')) {
+        if (item.empty() || item.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        cells.push_back(std::stoi(item));
+    }
+    return !cells.empty();
+}
+
+}
+
+bool DeadlockPatternStore::load(const char* filename, const std::vector<std::string>& levelFiles) {
+    entries.clear();
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::unordered_set<uint64_t> layouts;
+    for (const std::string& path : levelFiles) {
+        Level level;
+        if (loadLevelFromFile(path.c_str(), &level)) {
+            layouts.insert(levelLayoutHash(level, level.playerStartX, level.playerStartY));
+        }
+    }
+    
+    size_t dropped = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        uint64_t layout;
+        std::string boxes, area;
+        StoredPattern pattern;
+        
+        if (ss >> std::hex >> layout >> boxes >> area && readCells(boxes, pattern.boxes) &&
+            readCells(area, pattern.area)) {
+            if (levelFiles.empty() || layouts.count(layout)) {
+                entries[layout].push_back(pattern);
+            } else {
+                dropped++;
+            }
+        }
+    }
+    
+    if (dropped > 0) {
+        std::cout << "Deadlock patterns: dropped " << dropped << " patterns for changed or removed levels" << std::endl;
+    }
+    return true;
+}
+
+bool DeadlockPatternStore::save(const char* filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    for (const auto& layout : entries) {
+        for (const StoredPattern& pattern : layout.second) {
+            file << std::hex << layout.first << std::dec << " ";
+            writeCells(file, pattern.boxes);
+            file << " ";
+            writeCells(file, pattern.area);
+            file << "\n";
+        }
+    }
+    
+    return true;
+}
+
+void DeadlockPatternStore::fill(const Level& level, int playerX, int playerY, const SolverContext& context,
+                                DeadlockPatterns& out) const {
+    auto layout = entries.find(levelLayoutHash(level, playerX, playerY));
+    if (layout == entries.end()) {
+        return;
+    }
+    
+    for (const StoredPattern& stored : layout->second) {
+        DeadlockPattern pattern;
+        if (floorCells(stored.boxes, context, pattern.boxes) && floorCells(stored.area, context, pattern.area)) {
+            out.add(pattern);
+        }
+    }
+}
+
+int DeadlockPatternStore::merge(const Level& level, int playerX, int playerY, const SolverContext& context,
+                                const DeadlockPatterns& learned) {
+    std::vector<StoredPattern>& stored = entries[levelLayoutHash(level, playerX, playerY)];
+    int added = 0;
+    for (const DeadlockPattern& pattern : learned.all()) {
+        StoredPattern board;
+        board.boxes = boardCells(pattern.boxes, context);
+        board.area = boardCells(pattern.area, context);
+        if (stored.size() < DeadlockPatterns::MAX_PATTERNS &&
+            std::find(stored.begin(), stored.end(), board) == stored.end()) {
+            stored.push_back(board);
+            added++;
+        }
+    }
+    return added;
+}
+
+size_t DeadlockPatternStore::size() const {
+    size_t total = 0;
+    for (const auto& layout : entries) {
+        total += layout.second.size();
+    }
+    return total;
+}
@@ -14,6 +14,9 @@
 #include "include/game_init.h"
 #include "include/renderer.h"
 #include "include/solver.h"
+#include "include/solve_job.h"
+#include "include/solution_cache.h"
+#include "include/deadlock_patterns.h"
 
 bool checkWinCondition(Level* level);
 
@@ -46,16 +49,23 @@ SDL_Texture* tutorialTexture = nullptr;
 
 std::vector<std::string> dynamicLevelFiles;
 
+void loadCurrentLevel() {
+    if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
+        std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
+        exit(-1);
+    }
+    prepareLevelContext(game.activeLevel);
+}
+
 void initGame() {
     game.currentState = MENU;
     
     scanLevelsDirectory("levels");
+    solutionCache.load(SOLUTION_CACHE_FILE, dynamicLevelFiles);
+    deadlockPatternStore.load(DEADLOCK_PATTERN_FILE, dynamicLevelFiles);
     
     if (totalLoadedLevels > 0) {
-        if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-            std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-            exit(-1);
-        }
+        loadCurrentLevel();
     } else {
         std::cerr << "No level files found in 'levels' directory" << std::endl;
         exit(-1);
@@ -285,6 +295,7 @@ bool initGameResources(SDL_Renderer* renderer) {
 }
 
 void cleanupGameResources() {
+    solveJob.stop();
     cleanupMenuResources();
     gameTextures.destroyTextures();
     if (backgroundMusic) {
@@ -297,7 +308,54 @@ void cleanupGameResources() {
     }
 }
 
+// Cancels the background solve once the board no longer matches what it is
+// solving, and takes its result when it finishes.
+void updateSolveJob() {
+    if (solveJob.reap() > 0) {
+        deadlockPatternStore.save(DEADLOCK_PATTERN_FILE);
+    }
+    if (!solveJob.active()) {
+        return;
+    }
+    if (!solveJob.matches(game.activeLevel)) {
+        solveJob.cancel();
+    }
+    
+    std::vector<char> solution;
+    SolveStats stats;
+    if (!solveJob.collect(solution, stats)) {
+        return;
+    }
+    
+    solverNodesExplored = stats.nodesExplored;
+    solverMaxQueueSize = stats.maxQueueSize;
+    solverExecutionTimeMs = stats.executionTimeMs;
+    solverRunning = false;
+    currentSolutionStep = 0;
+    if (stats.patternsLearned > 0) {
+        deadlockPatternStore.save(DEADLOCK_PATTERN_FILE);
+    }
+    
+    if (stats.cancelled || !solverActive || !solveJob.matches(game.activeLevel)) {
+        solverActive = false;
+        solverFoundSolution = false;
+        solverSolution.clear();
+        return;
+    }
+    
+    solverSolution = solution;
+    solverFoundSolution = !solverSolution.empty();
+    lastSolutionStepTime = SDL_GetTicks();
+    
+    if (solverFoundSolution) {
+        solutionCache.store(game.activeLevel, solveJob.getStartX(), solveJob.getStartY(), solverSolution);
+        solutionCache.save(SOLUTION_CACHE_FILE);
+    }
+}
+
 void updateGame() {
+    updateSolveJob();
+    
     if (game.currentState == PLAYING && checkWinCondition(&game.activeLevel)) {
         game.isNewRecord = isNewHighScore(currentLevelIndex, game.player.moves, game.player.pushes);
         
@@ -305,6 +363,7 @@ void updateGame() {
             saveHighScores("highscores.dat");
         }
         
+        solveJob.cancel();
         solverActive = false;
         solverRunning = false;
         solverFoundSolution = false;
@@ -165,6 +165,42 @@ bool loadLevelFromFile(const char* filename, Level* outLevel) {
     return true;
 }
 
+void copyLevel(const Level& source, Level* outLevel) {
+    if (outLevel->currentMap) {
+        for (int y = 0; y < outLevel->height; y++) {
+            delete[] outLevel->currentMap[y];
+        }
+        delete[] outLevel->currentMap;
+        outLevel->currentMap = nullptr;
+    }
+    
+    if (outLevel->originalMap) {
+        for (int y = 0; y < outLevel->height; y++) {
+            delete[] outLevel->originalMap[y];
+        }
+        delete[] outLevel->originalMap;
+        outLevel->originalMap = nullptr;
+    }
+    
+    outLevel->width = source.width;
+    outLevel->height = source.height;
+    outLevel->playerStartX = source.playerStartX;
+    outLevel->playerStartY = source.playerStartY;
+    
+    outLevel->originalMap = new TileType*[source.height];
+    outLevel->currentMap = new TileType*[source.height];
+    
+    for (int y = 0; y < source.height; y++) {
+        outLevel->originalMap[y] = new TileType[source.width];
+        outLevel->currentMap[y] = new TileType[source.width];
+        
+        for (int x = 0; x < source.width; x++) {
+            outLevel->originalMap[y][x] = source.originalMap[y][x];
+            outLevel->currentMap[y][x] = source.currentMap[y][x];
+        }
+    }
+}
+
 void recordMove(const MoveRecord& move) {
     game.moveHistory.push_back(move);
 }
@@ -2,364 +2,898 @@
 
 #include <vector>
 #include <queue>
-#include <unordered_map>
-#include <unordered_set>
 #include <algorithm>
 #include <functional>
 #include <iostream>
 #include <cstring>
-#include <sstream>
+#include <cstdint>
 #include "game_structures.h"
+#include "solver_context.h"
+#include "solver_arena.h"
+#include "solver_queue.h"
+#include "box_matching.h"
+#include "transposition_table.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
 
-struct Position {
-    int x, y;
-    
-    Position(int x = 0, int y = 0) : x(x), y(y) {}
-    
-    bool operator==(const Position& other) const {
-        return x == other.x && y == other.y;
-    }
-    
-    bool operator!=(const Position& other) const {
-        return !(*this == other);
-    }
-    
-    bool operator<(const Position& other) const {
-        if (x != other.x) return x < other.x;
-        return y < other.y;
-    }
+enum SolverMode {
+    SOLVER_MODE_STEPS,
+    SOLVER_MODE_PUSHES
 };
 
-namespace std {
-    template<>
-    struct hash<Position> {
-        size_t operator()(const Position& pos) const {
-            return hash<int>()(pos.x) ^ (hash<int>()(pos.y) << 1);
-        }
-    };
-}
+// Expanded nodes only remember how they were reached; the move string is
+// rebuilt by walking parents back to the root once a goal is found.
+struct SearchNode {
+    int parent;
+    uint32_t move;
+    
+    SearchNode(int parent = -1, uint32_t move = 0) : parent(parent), move(move) {}
+};
 
 struct SolverState {
-    std::vector<std::vector<TileType>> board;
-    Position playerPos;
-    std::vector<Position> boxes;
-    std::vector<Position> targets;
+    PackedState packed;
     int g;
     int h;
-    std::string path;
+    int parent;
+    uint32_t move;
+    // Two independent Zobrist keys. The closed table stores both, so states
+    // are only merged if both keys collide.
+    uint64_t hash;
+    uint64_t hashCheck;
     
-    SolverState() : g(0), h(0) {}
+    SolverState() : g(0), h(0), parent(-1), move(0), hash(0), hashCheck(0) {}
     
     int f() const { return g + h; }
-    
-    bool operator==(const SolverState& other) const {
-        if (playerPos != other.playerPos) return false;
-        
-        std::vector<Position> sortedBoxes = boxes;
-        std::vector<Position> otherSortedBoxes = other.boxes;
-        std::sort(sortedBoxes.begin(), sortedBoxes.end());
-        std::sort(otherSortedBoxes.begin(), otherSortedBoxes.end());
-        
-        return sortedBoxes == otherSortedBoxes;
-    }
-};
-
-namespace std {
-    template<>
-    struct hash<SolverState> {
-        size_t operator()(const SolverState& state) const {
-            size_t h = hash<Position>()(state.playerPos);
-            
-            std::vector<Position> sortedBoxes = state.boxes;
-            std::sort(sortedBoxes.begin(), sortedBoxes.end());
-            
-            for (const Position& box : sortedBoxes) {
-                h ^= hash<Position>()(box) + 0x9e3779b9 + (h << 6) + (h >> 2);
-            }
-            
-            return h;
-        }
-    };
-}
-
-struct SolverStateComparator {
-    bool operator()(const SolverState& a, const SolverState& b) const {
-        return a.f() > b.f();
-    }
 };
 
 class AdvancedSolver {
 private:
+    enum CorralResult {
+        CORRAL_NONE,
+        CORRAL_RESTRICT,
+        CORRAL_DEADLOCK
+    };
+    
+    // States a corral sub-search may expand before giving up without a verdict.
+    static const int CORRAL_SEARCH_LIMIT = 500;
+    
+    // Slots of the sub-search's visited set, a power of two at least twice
+    // CORRAL_SEARCH_LIMIT so linear probing stays short. A slot belongs to
+    // the current sub-search only while its stamp matches.
+    static const int CORRAL_VISITED_SLOTS = 1024;
+    struct CorralVisit {
+        uint64_t key;
+        uint32_t stamp;
+    };
+    
+    // Default search budgets, and the fractions of the memory budget given
+    // to the closed table, its Bloom filter and the corral verdicts.
+    static const size_t DEFAULT_MEMORY_MB = 512;
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    static const size_t CLOSED_TABLE_SHARE = 4;
+    static const size_t CLOSED_BLOOM_SHARE = 64;
+    static const size_t CORRAL_VERDICT_SHARE = 64;
+    
+    // A remembered corral sub-search result. Entries of an older age are
+    // empty; a new verdict simply overwrites whatever shares its slot.
+    struct CorralVerdict {
+        uint64_t key;
+        uint8_t age;
+        bool deadlock;
+    };
+    
+    // Heuristic value of a state that can never be solved.
+    static const int DEADLOCK = BoxMatching::INFINITE_COST;
+    
     const int dx[4] = {0, 1, 0, -1};
     const int dy[4] = {-1, 0, 1, 0};
     const char dirChars[4] = {'U', 'R', 'D', 'L'};
     
-    Level level;
+    SolverContext context;
+    bool contextReady;
+    SolverMode mode;
+    bool macroMoves;
+    
+    std::vector<char> reachable;
+    std::vector<int> cellStack;
+    std::vector<int> corralLabel;
+    std::vector<int> corralCells;
+    std::vector<PushMove> pushList;
+    std::vector<PushMove> macroPushes;
+    std::vector<char> corralRegion;
+    std::vector<char> corralArea;
+    std::vector<PackedState> corralQueue;
+    std::vector<PushMove> corralPushList;
+    std::vector<PushMove> corralCandidates;
+    std::vector<CorralVisit> corralVisited;
+    uint32_t corralStamp;
+    int corralVisitedCount;
+    std::vector<CorralVerdict> corralVerdicts;
+    size_t corralVerdictMask;
+    size_t corralVerdictCount;
+    uint8_t corralAge;
+    DeadlockPatterns* patterns;
+    BoxMatching matching;
+    BoxMatching childMatching;
+    SolverArena arena;
+    ArenaTable<SearchNode> nodes;
+    TranspositionTable closedTable;
+    ArenaTable<SolverState> openStates;
+    std::vector<int> freeSlots;
+    BucketQueue openSet;
     
     int nodesExplored;
     int maxQueueSize;
+    int hashCollisions;
+    int corralPrunes;
+    int patternPrunes;
+    int patternsLearned;
+    int macroChildren;
+    bool limitReached;
+    bool timedOut;
+    bool cancelled;
+    int lastH;
+    ProgressReporter progress;
+    SolverControl* control;
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    int nodeLimit;
+    size_t arenaBytesReserved;
+    size_t arenaBytesUsed;
+    size_t peakBytes;
     long long executionTimeMs;
     
-    void findTargets(const Level& level, std::vector<Position>& targets) {
-        targets.clear();
-        for (int y = 0; y < level.height; y++) {
-            for (int x = 0; x < level.width; x++) {
-                if (level.originalMap[y][x] == TARGET) {
-                    targets.push_back(Position(x, y));
-                }
-            }
+    bool levelToState(const Level& level, int playerX, int playerY, SolverState& state) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "Solver: level has no usable floor or more than "
+                      << MAX_FLOOR_CELLS << " floor cells" << std::endl;
+            return false;
+        }
+        if (!context.packState(level, playerX, playerY, state.packed)) {
+            std::cout << "Solver: box or player outside the playable floor" << std::endl;
+            return false;
         }
+        reachable.assign(context.floorCount, 0);
+        return true;
     }
     
-    void findBoxes(const std::vector<std::vector<TileType>>& board, std::vector<Position>& boxes) {
-        boxes.clear();
-        for (size_t y = 0; y < board.size(); y++) {
-            for (size_t x = 0; x < board[y].size(); x++) {
-                if (board[y][x] == BOX || board[y][x] == BOX_ON_TARGET) {
-                    boxes.push_back(Position(x, y));
-                }
-            }
+    // Lower bound on the pushes left: the cheapest assignment of boxes to
+    // distinct targets by push distance. Every push is also a move, so the
+    // bound holds for step search too. Leaves the assignment in `matching`.
+    int calculateHeuristic(const PackedState& state) {
+        if (state.boxes.count() == 0 || context.targetCells.empty()) {
+            return DEADLOCK;
         }
+        
+        matching.assign(context, state.boxes);
+        return matching.cost();
     }
     
-    SolverState levelToState(const Level& level, int playerX, int playerY) {
-        SolverState state;
-        
-        state.board.resize(level.height);
-        for (int y = 0; y < level.height; y++) {
-            state.board[y].resize(level.width);
-            for (int x = 0; x < level.width; x++) {
-                state.board[y][x] = level.currentMap[y][x];
-            }
+    // Heuristic of the child reached by pushing a box from `from` to `to`,
+    // repaired from the parent's assignment in `matching`.
+    int pushHeuristic(int from, int to) {
+        childMatching = matching;
+        childMatching.moveBox(from, to);
+        return childMatching.cost();
+    }
+    
+    bool checkWinCondition(const PackedState& state) {
+        return state.boxes.isSubsetOf(context.targets);
+    }
+    
+    void computeStateHash(SolverState& state) {
+        const ZobristTable& zobrist = context.zobrist;
+        state.hash = zobrist.playerKeys[state.packed.player];
+        state.hashCheck = zobrist.playerCheckKeys[state.packed.player];
+        const BoxSet& boxes = state.packed.boxes;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            state.hash ^= zobrist.boxKeys[box];
+            state.hashCheck ^= zobrist.boxCheckKeys[box];
         }
-        
-        state.playerPos = Position(playerX, playerY);
-        
-        findTargets(level, state.targets);
-        
-        findBoxes(state.board, state.boxes);
-        
-        return state;
     }
     
-    bool isValidPosition(const std::vector<std::vector<TileType>>& board, int x, int y) {
-        if (x < 0 || y < 0 || y >= (int)board.size() || x >= (int)board[0].size()) {
-            return false;
+    void hashPlayerMove(SolverState& state, int from, int to) {
+        const ZobristTable& zobrist = context.zobrist;
+        state.hash ^= zobrist.playerKeys[from] ^ zobrist.playerKeys[to];
+        state.hashCheck ^= zobrist.playerCheckKeys[from] ^ zobrist.playerCheckKeys[to];
+    }
+    
+    void hashBoxMove(SolverState& state, int from, int to) {
+        const ZobristTable& zobrist = context.zobrist;
+        state.hash ^= zobrist.boxKeys[from] ^ zobrist.boxKeys[to];
+        state.hashCheck ^= zobrist.boxCheckKeys[from] ^ zobrist.boxCheckKeys[to];
+    }
+    
+    // Marks the state closed. Returns false if it or a symmetric image of
+    // it already was at the same or a lower g; a primary key
+    // match with a different check key is counted as a collision and the
+    // state is kept as a new one. `region` is the player's reachable area
+    // in push search and null in step search.
+    bool insertClosed(const SolverState& state, const std::vector<char>* region) {
+        uint64_t hash = state.hash;
+        uint64_t check = state.hashCheck;
+        if (!context.symmetries.empty()) {
+            context.canonicalKeys(state.packed, region, hash, check);
         }
-        return board[y][x] != WALL;
+        bool collision;
+        bool inserted = closedTable.insert(hash, check, state.g, collision);
+        if (collision) {
+            hashCollisions++;
+        }
+        return inserted;
     }
     
-    bool isBoxInCorner(const std::vector<std::vector<TileType>>& board, int x, int y) {
-        if (board[y][x] == BOX_ON_TARGET) return false;
-        
-        bool wallUp = !isValidPosition(board, x, y-1) || board[y-1][x] == WALL;
-        bool wallDown = !isValidPosition(board, x, y+1) || board[y+1][x] == WALL;
-        bool wallLeft = !isValidPosition(board, x-1, y) || board[y][x-1] == WALL;
-        bool wallRight = !isValidPosition(board, x+1, y) || board[y][x+1] == WALL;
-        
-        return (wallUp && wallLeft) || (wallUp && wallRight) || 
-               (wallDown && wallLeft) || (wallDown && wallRight);
+    // Queued states live in a recycled slot table; the queue only moves
+    // their handles.
+    void pushOpen(const SolverState& state) {
+        int slot;
+        if (freeSlots.empty()) {
+            slot = openStates.push(state);
+        } else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            openStates[slot] = state;
+        }
+        openSet.push(slot, state.f(), state.h);
     }
     
-    bool isBoxStuckAgainstWall(const std::vector<std::vector<TileType>>& board, const std::vector<Position>& targets, int x, int y) {
-        if (board[y][x] == BOX_ON_TARGET) return false;
-        
-        bool wallUp = !isValidPosition(board, x, y-1) || board[y-1][x] == WALL;
-        bool wallDown = !isValidPosition(board, x, y+1) || board[y+1][x] == WALL;
-        bool wallLeft = !isValidPosition(board, x-1, y) || board[y][x-1] == WALL;
-        bool wallRight = !isValidPosition(board, x+1, y) || board[y][x+1] == WALL;
-        
-        if (wallUp || wallDown) {
-            for (const Position& target : targets) {
-                if (target.y == y) return false;
-            }
+    // The closed table is allocated up front; the node and open tables may
+    // use the rest of the memory budget. Running out of memory sets
+    // limitReached, running out of time or of the node limit sets
+    // timedOut. The same poll reports progress and notices a cancel request.
+    bool budgetExceeded(long long startTime) {
+        if (arena.bytesReserved() + closedTable.bytes() + corralVerdicts.size() * sizeof(CorralVerdict) >
+            memoryBudgetMb << 20) {
+            limitReached = true;
             return true;
         }
-        
-        if (wallLeft || wallRight) {
-            for (const Position& target : targets) {
-                if (target.x == x) return false;
-            }
+        if ((nodesExplored & 1023) != 0) {
+            return false;
+        }
+        progress.report(nodesExplored, openSet.size(), lastH);
+        if (progress.cancelled()) {
+            cancelled = true;
+            return true;
+        }
+        if ((int)(solverClockMs() - startTime) >= timeLimitMs || (nodeLimit > 0 && nodesExplored >= nodeLimit)) {
+            timedOut = true;
             return true;
         }
-        
         return false;
     }
     
-    int calculateHeuristic(const SolverState& state) {
-        int h = 0;
-        
-        if (state.boxes.empty() || state.targets.empty()) {
-            return 1000;
+    bool popOpen(SolverState& state) {
+        int slot = openSet.pop();
+        if (slot < 0) {
+            return false;
         }
+        state = openStates[slot];
+        freeSlots.push_back(slot);
+        lastH = state.h;
+        return true;
+    }
+    
+    // Flood fills the cells the player can walk to without pushing into
+    // `region` and returns the lowest one, which stands for the region.
+    int computeReachable(const BoxSet& boxes, int start, std::vector<char>& region) {
+        region.assign(context.floorCount, 0);
+        cellStack.clear();
+        cellStack.push_back(start);
+        region[start] = 1;
+        int normalized = start;
         
-        for (const Position& box : state.boxes) {
-            if (isBoxInCorner(state.board, box.x, box.y) || 
-                isBoxStuckAgainstWall(state.board, state.targets, box.x, box.y)) {
-                return 1000;
-            }
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            normalized = std::min(normalized, cell);
             
-            int minDistance = INT_MAX;
-            for (const Position& target : state.targets) {
-                int distance = abs(box.x - target.x) + abs(box.y - target.y);
-                minDistance = std::min(minDistance, distance);
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context.neighbour(cell, dir);
+                if (next >= 0 && !region[next] && !boxes.test(next)) {
+                    region[next] = 1;
+                    cellStack.push_back(next);
+                }
             }
-            h += minDistance;
         }
         
-        int minPlayerBoxDist = INT_MAX;
-        for (const Position& box : state.boxes) {
-            if (state.board[box.y][box.x] != BOX_ON_TARGET) {
-                int distance = abs(state.playerPos.x - box.x) + abs(state.playerPos.y - box.y);
-                minPlayerBoxDist = std::min(minPlayerBoxDist, distance);
+        return normalized;
+    }
+    
+    // Every push the player can make from `region` that does not move a box
+    // onto a dead square or into another box.
+    void collectPushes(const BoxSet& boxes, const std::vector<char>& region, std::vector<PushMove>& pushes) {
+        pushes.clear();
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int from = context.neighbour(box, (dir + 2) % 4);
+                int to = context.neighbour(box, dir);
+                if (from >= 0 && region[from] && to >= 0 && !boxes.test(to) && !context.isDead(to)) {
+                    pushes.push_back(PushMove(box, dir));
+                }
             }
         }
+    }
+    
+    // Forgets the verdicts of the last solve, sizing the table from the
+    // memory budget the first time.
+    void newCorralAge() {
+        if (corralVerdicts.empty()) {
+            size_t count = 1;
+            while (count * 2 * sizeof(CorralVerdict) <= (memoryBudgetMb << 20) / CORRAL_VERDICT_SHARE) {
+                count *= 2;
+            }
+            corralVerdicts.assign(count, CorralVerdict());
+            corralVerdictMask = count - 1;
+            corralAge = 0;
+        }
+        corralAge++;
+        if (corralAge == 0) {
+            std::fill(corralVerdicts.begin(), corralVerdicts.end(), CorralVerdict());
+            corralAge = 1;
+        }
+        corralVerdictCount = 0;
+    }
+    
+    uint64_t boxSetHash(const BoxSet& boxes) {
+        uint64_t hash = 0;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            hash ^= context.zobrist.boxKeys[box];
+        }
+        return hash;
+    }
+    
+    // Relaxed search on a corral: every box outside it is removed, which can
+    // only help the player. The corral is resolved if its boxes all reach
+    // targets or one of them leaves the area the player could not enter at
+    // the start. Running out of states proves a deadlock; running out of
+    // budget proves nothing.
+    bool isCorralDeadlock(const BoxSet& corralBoxes, int player) {
+        int start = computeReachable(corralBoxes, player, corralRegion);
+        uint64_t key = boxSetHash(corralBoxes) ^ context.zobrist.playerKeys[start];
         
-        if (minPlayerBoxDist < INT_MAX) {
-            h += minPlayerBoxDist;
+        CorralVerdict& verdict = corralVerdicts[key & corralVerdictMask];
+        if (verdict.age == corralAge && verdict.key == key) {
+            return verdict.deadlock;
         }
         
-        return h;
+        bool deadlock = searchCorral(corralBoxes, start, corralRegion);
+        corralVerdictCount += verdict.age != corralAge;
+        verdict.key = key;
+        verdict.age = corralAge;
+        verdict.deadlock = deadlock;
+        if (deadlock && patterns) {
+            learnPattern(corralBoxes, start);
+        }
+        return deadlock;
+    }
+    
+    // Starts an empty visited set for the next sub-search, wiping the slots
+    // only when the stamp wraps around.
+    void newCorralVisited() {
+        if (corralVisited.empty()) {
+            corralVisited.assign(CORRAL_VISITED_SLOTS, CorralVisit());
+        }
+        corralStamp++;
+        if (corralStamp == 0) {
+            std::fill(corralVisited.begin(), corralVisited.end(), CorralVisit());
+            corralStamp = 1;
+        }
+        corralVisitedCount = 0;
     }
     
-    bool checkWinCondition(const SolverState& state) {
-        for (const Position& box : state.boxes) {
-            if (state.board[box.y][box.x] != BOX_ON_TARGET) {
+    // Adds `key` to the sub-search's visited set; false if it was there.
+    bool visitCorralState(uint64_t key) {
+        size_t slot = key & (CORRAL_VISITED_SLOTS - 1);
+        while (corralVisited[slot].stamp == corralStamp) {
+            if (corralVisited[slot].key == key) {
                 return false;
             }
+            slot = (slot + 1) & (CORRAL_VISITED_SLOTS - 1);
         }
+        corralVisited[slot].key = key;
+        corralVisited[slot].stamp = corralStamp;
+        corralVisitedCount++;
         return true;
     }
     
-    std::string createStateHash(const SolverState& state) {
-        std::stringstream ss;
+    // The sub-search behind isCorralDeadlock, with `region` the cells the
+    // player reaches from `start` when only `corralBoxes` stand.
+    bool searchCorral(const BoxSet& corralBoxes, int start, std::vector<char>& region) {
+        corralArea.resize(context.floorCount);
+        for (int cell = 0; cell < context.floorCount; cell++) {
+            corralArea[cell] = !region[cell];
+        }
         
-        ss << state.playerPos.y << "," << state.playerPos.x << "|";
+        newCorralVisited();
+        corralQueue.clear();
+        PackedState initial;
+        initial.boxes = corralBoxes;
+        initial.player = start;
+        corralQueue.push_back(initial);
         
-        std::vector<Position> sortedBoxes = state.boxes;
-        std::sort(sortedBoxes.begin(), sortedBoxes.end());
+        bool deadlock = true;
+        for (size_t head = 0; head < corralQueue.size() && deadlock; head++) {
+            if (corralVisitedCount >= CORRAL_SEARCH_LIMIT) {
+                deadlock = false;
+                break;
+            }
+            
+            PackedState state = corralQueue[head];
+            int normalized = computeReachable(state.boxes, state.player, region);
+            if (!visitCorralState(boxSetHash(state.boxes) ^ context.zobrist.playerKeys[normalized])) {
+                continue;
+            }
+            if (checkWinCondition(state)) {
+                deadlock = false;
+                break;
+            }
+            
+            collectPushes(state.boxes, region, corralPushList);
+            for (const PushMove& push : corralPushList) {
+                int to = context.neighbour(push.box, push.dir);
+                if (!corralArea[to]) {
+                    deadlock = false;
+                    break;
+                }
+                
+                PackedState next = state;
+                next.boxes.reset(push.box);
+                next.boxes.set(to);
+                if (context.isFreezeDeadlock(next.boxes, to)) {
+                    continue;
+                }
+                next.player = push.box;
+                corralQueue.push_back(next);
+            }
+        }
         
-        for (const Position& box : sortedBoxes) {
-            ss << box.y << "," << box.x << ";";
+        return deadlock;
+    }
+    
+    // Drops every box the deadlock still holds without, then keeps what is
+    // left as a pattern if it is small enough to be met again.
+    void learnPattern(const BoxSet& corralBoxes, int player) {
+        if (corralBoxes.count() > 2 * DeadlockPatterns::MAX_PATTERN_BOXES) {
+            return;
         }
         
-        return ss.str();
+        BoxSet kept = corralBoxes;
+        for (int box = corralBoxes.next(0); box >= 0 && kept.count() > 1; box = corralBoxes.next(box + 1)) {
+            BoxSet fewer = kept;
+            fewer.reset(box);
+            if (searchCorral(fewer, computeReachable(fewer, player, corralRegion), corralRegion)) {
+                kept = fewer;
+            }
+        }
+        if (kept.count() > DeadlockPatterns::MAX_PATTERN_BOXES) {
+            return;
+        }
+        
+        DeadlockPattern pattern;
+        pattern.boxes = kept;
+        computeReachable(kept, player, corralRegion);
+        for (int cell = 0; cell < context.floorCount; cell++) {
+            if (!corralRegion[cell]) {
+                pattern.area.set(cell);
+            }
+        }
+        if (patterns->add(pattern)) {
+            patternsLearned++;
+        }
     }
-
-public:
-    AdvancedSolver() : nodesExplored(0), maxQueueSize(0), executionTimeMs(0) {}
     
-    std::string solve(const Level& level, int playerX, int playerY) {
-        nodesExplored = 0;
-        maxQueueSize = 0;
-        Uint32 startTime = SDL_GetTicks();
+    // Looks for PI-corrals: areas the player cannot reach, fenced by boxes
+    // that can only be pushed into the area (I) and whose pushes into it the
+    // player can all make from where it stands (P). An unfinished PI-corral
+    // has to be pushed into sooner or later, so the one needing the fewest
+    // pushes restricts the successors to those pushes, unless its
+    // sub-search shows that it is already lost.
+    CorralResult analyzeCorrals(const BoxSet& boxes, int player, std::vector<PushMove>& corralPushes) {
+        corralLabel.assign(context.floorCount, -1);
+        BoxSet bestBoxes;
+        bool found = false;
+        int labels = 0;
+        
+        for (int start = 0; start < context.floorCount; start++) {
+            if (reachable[start] || boxes.test(start) || corralLabel[start] >= 0) {
+                continue;
+            }
+            
+            int label = labels++;
+            BoxSet corralBoxes;
+            bool openTarget = false;
+            corralCells.clear();
+            corralCells.push_back(start);
+            corralLabel[start] = label;
+            
+            for (size_t head = 0; head < corralCells.size(); head++) {
+                int cell = corralCells[head];
+                openTarget = openTarget || context.isTarget(cell);
+                for (int dir = 0; dir < 4; dir++) {
+                    int next = context.neighbour(cell, dir);
+                    if (next < 0) continue;
+                    if (boxes.test(next)) {
+                        corralBoxes.set(next);
+                    } else if (corralLabel[next] < 0) {
+                        corralLabel[next] = label;
+                        corralCells.push_back(next);
+                    }
+                }
+            }
+            
+            if (!openTarget && corralBoxes.isSubsetOf(context.targets)) {
+                continue;
+            }
+            
+            corralCandidates.clear();
+            bool isPI = true;
+            for (int box = corralBoxes.next(0); box >= 0 && isPI; box = corralBoxes.next(box + 1)) {
+                for (int dir = 0; dir < 4; dir++) {
+                    int from = context.neighbour(box, (dir + 2) % 4);
+                    int to = context.neighbour(box, dir);
+                    if (from < 0 || to < 0) continue;
+                    
+                    bool intoCorral = corralLabel[to] == label;
+                    if (reachable[from]) {
+                        if (boxes.test(to) || context.isDead(to)) continue;
+                        if (!intoCorral) {
+                            isPI = false;
+                            break;
+                        }
+                        corralCandidates.push_back(PushMove(box, dir));
+                    } else if (intoCorral && !boxes.test(to)) {
+                        isPI = false;
+                        break;
+                    }
+                }
+            }
+            
+            if (isPI && !corralCandidates.empty() && (!found || corralCandidates.size() < corralPushes.size())) {
+                corralPushes = corralCandidates;
+                bestBoxes = corralBoxes;
+                found = true;
+            }
+        }
+        
+        if (!found) {
+            return CORRAL_NONE;
+        }
+        return isCorralDeadlock(bestBoxes, player) ? CORRAL_DEADLOCK : CORRAL_RESTRICT;
+    }
+    
+    // The pushes one stored move stands for: with macro moves a push into a
+    // tunnel or goal room goes on as the context lays out, otherwise it is
+    // the push alone.
+    void expandMove(const BoxSet& boxes, const PushMove& push, std::vector<PushMove>& pushes) {
+        if (macroMoves) {
+            context.expandPush(boxes, push, pushes);
+        } else {
+            pushes.assign(1, push);
+        }
+    }
+    
+    // Move codes from the root to `goal`, which has not been added to the
+    // node table itself.
+    std::vector<uint32_t> collectMoves(const SolverState& goal) {
+        std::vector<uint32_t> moves;
+        if (goal.parent < 0) {
+            return moves;
+        }
+        moves.push_back(goal.move);
+        for (int index = goal.parent; nodes[index].parent >= 0; index = nodes[index].parent) {
+            moves.push_back(nodes[index].move);
+        }
+        std::reverse(moves.begin(), moves.end());
+        return moves;
+    }
+    
+    std::string rebuildStepPath(const SolverState& goal) {
+        std::string path;
+        for (uint32_t move : collectMoves(goal)) {
+            path += dirChars[move];
+        }
+        return path;
+    }
+    
+    // Replays the push sequence from the real start position and fills in
+    // the player walks between pushes.
+    std::string rebuildPushPath(const PackedState& start, const SolverState& goal) {
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        std::string path;
+        std::string walk;
         
-        SolverState initialState = levelToState(level, playerX, playerY);
-        initialState.h = calculateHeuristic(initialState);
+        for (uint32_t move : collectMoves(goal)) {
+            expandMove(boxes, decodePushMove(move), macroPushes);
+            for (const PushMove& push : macroPushes) {
+                int pushFrom = context.neighbour(push.box, (push.dir + 2) % 4);
+                if (pushFrom < 0 || !context.findWalk(boxes, player, pushFrom, walk)) {
+                    return "";
+                }
+                path += walk;
+                path += dirChars[push.dir];
+                
+                boxes.reset(push.box);
+                boxes.set(context.neighbour(push.box, push.dir));
+                player = push.box;
+            }
+        }
         
-        std::priority_queue<SolverState, std::vector<SolverState>, SolverStateComparator> openSet;
-        openSet.push(initialState);
+        return path;
+    }
+    
+    std::string solveSteps(const Level& level, int playerX, int playerY) {
+        long long startTime = solverClockMs();
         
-        std::unordered_set<std::string> closedSet;
+        SolverState initialState;
+        if (!levelToState(level, playerX, playerY, initialState)) {
+            return "";
+        }
+        initialState.h = calculateHeuristic(initialState.packed);
+        if (initialState.h >= DEADLOCK) {
+            return "";
+        }
+        computeStateHash(initialState);
         
-        int explorationLimit = std::min(1000000, 20000 * level.width * level.height);
+        pushOpen(initialState);
         
-        while (!openSet.empty() && nodesExplored < explorationLimit) {
-            SolverState current = openSet.top();
-            openSet.pop();
-            
+        SolverState current;
+        while (!budgetExceeded(startTime) && popOpen(current)) {
             nodesExplored++;
             maxQueueSize = std::max(maxQueueSize, (int)openSet.size());
             
-            std::string stateHash = createStateHash(current);
-            
-            if (closedSet.count(stateHash) > 0) {
-                continue;
+            if (checkWinCondition(current.packed)) {
+                executionTimeMs = solverClockMs() - startTime;
+                return rebuildStepPath(current);
             }
             
-            if (checkWinCondition(current)) {
-                executionTimeMs = SDL_GetTicks() - startTime;
-                return current.path;
+            if (!insertClosed(current, nullptr)) {
+                continue;
             }
             
-            closedSet.insert(stateHash);
+            int currentIndex = nodes.push(SearchNode(current.parent, current.move));
+            matching.assign(context, current.packed.boxes);
             
+            int player = current.packed.player;
             for (int dir = 0; dir < 4; dir++) {
-                int nx = current.playerPos.x + dx[dir];
-                int ny = current.playerPos.y + dy[dir];
-                
-                if (!isValidPosition(current.board, nx, ny)) {
+                int next = context.neighbour(player, dir);
+                if (next < 0) {
                     continue;
                 }
                 
+                int boxNext = -1;
+                if (current.packed.boxes.test(next)) {
+                    boxNext = context.neighbour(next, dir);
+                    if (boxNext < 0 || current.packed.boxes.test(boxNext) || context.isDead(boxNext)) {
+                        continue;
+                    }
+                }
+                
                 SolverState nextState = current;
-                nextState.path += dirChars[dir];
+                nextState.parent = currentIndex;
+                nextState.move = dir;
                 nextState.g += 1;
+                nextState.packed.player = next;
+                hashPlayerMove(nextState, player, next);
                 
-                if (current.board[ny][nx] == EMPTY || current.board[ny][nx] == TARGET) {
-                    nextState.playerPos = Position(nx, ny);
-                    
-                    if (current.board[ny][nx] == TARGET) {
-                        nextState.board[ny][nx] = PLAYER_ON_TARGET;
-                    } else {
-                        nextState.board[ny][nx] = PLAYER;
+                if (boxNext >= 0) {
+                    nextState.packed.boxes.reset(next);
+                    nextState.packed.boxes.set(boxNext);
+                    if (context.isFreezeDeadlock(nextState.packed.boxes, boxNext)) {
+                        continue;
                     }
-                    
-                    if (level.originalMap[current.playerPos.y][current.playerPos.x] == TARGET) {
-                        nextState.board[current.playerPos.y][current.playerPos.x] = TARGET;
-                    } else {
-                        nextState.board[current.playerPos.y][current.playerPos.x] = EMPTY;
-                    }
-                    
-                    nextState.h = calculateHeuristic(nextState);
-                    if (nextState.h < 1000) {
-                        openSet.push(nextState);
+                    if (patterns && patterns->matches(nextState.packed.boxes, boxNext, next)) {
+                        patternPrunes++;
+                        continue;
                     }
+                    hashBoxMove(nextState, next, boxNext);
                 }
-                else if (current.board[ny][nx] == BOX || current.board[ny][nx] == BOX_ON_TARGET) {
-                    int boxNextX = nx + dx[dir];
-                    int boxNextY = ny + dy[dir];
-                    
-                    if (isValidPosition(current.board, boxNextX, boxNextY) && 
-                        (current.board[boxNextY][boxNextX] == EMPTY || 
-                         current.board[boxNextY][boxNextX] == TARGET)) {
-                        
-                        nextState.board[boxNextY][boxNextX] = 
-                            (current.board[boxNextY][boxNextX] == TARGET) ? BOX_ON_TARGET : BOX;
-                        
-                        nextState.playerPos = Position(nx, ny);
-                        
-                        if (level.originalMap[current.playerPos.y][current.playerPos.x] == TARGET) {
-                            nextState.board[current.playerPos.y][current.playerPos.x] = TARGET;
-                        } else {
-                            nextState.board[current.playerPos.y][current.playerPos.x] = EMPTY;
-                        }
-                        
-                        if (level.originalMap[ny][nx] == TARGET) {
-                            nextState.board[ny][nx] = PLAYER_ON_TARGET;
-                        } else {
-                            nextState.board[ny][nx] = PLAYER;
-                        }
-                        
-                        nextState.boxes.clear();
-                        findBoxes(nextState.board, nextState.boxes);
-                        
-                        nextState.h = calculateHeuristic(nextState);
-                        if (nextState.h < 1000) {
-                            openSet.push(nextState);
-                        }
-                    }
+                
+                if (boxNext >= 0) {
+                    nextState.h = pushHeuristic(next, boxNext);
+                }
+                // Step states are exact, so closed ones can be dropped here
+                // before they take up open list space.
+                if (nextState.h < DEADLOCK && !closedTable.seen(nextState.hash, nextState.hashCheck, nextState.g)) {
+                    pushOpen(nextState);
                 }
             }
         }
         
-        executionTimeMs = SDL_GetTicks() - startTime;
+        executionTimeMs = solverClockMs() - startTime;
         return "";
     }
     
+    // Push-level search: every node is a box push. The player is only known
+    // up to the region it can walk to, keyed by that region's lowest cell.
+    std::string solvePushes(const Level& level, int playerX, int playerY) {
+        long long startTime = solverClockMs();
+        
+        SolverState initialState;
+        if (!levelToState(level, playerX, playerY, initialState)) {
+            return "";
+        }
+        initialState.h = calculateHeuristic(initialState.packed);
+        if (initialState.h >= DEADLOCK) {
+            return "";
+        }
+        computeStateHash(initialState);
+        
+        pushOpen(initialState);
+        
+        SolverState current;
+        while (!budgetExceeded(startTime) && popOpen(current)) {
+            nodesExplored++;
+            maxQueueSize = std::max(maxQueueSize, (int)openSet.size());
+            
+            const BoxSet& boxes = current.packed.boxes;
+            int normalized = computeReachable(boxes, current.packed.player, reachable);
+            hashPlayerMove(current, current.packed.player, normalized);
+            current.packed.player = normalized;
+            
+            if (checkWinCondition(current.packed)) {
+                executionTimeMs = solverClockMs() - startTime;
+                return rebuildPushPath(initialState.packed, current);
+            }
+            
+            if (!insertClosed(current, &reachable)) {
+                continue;
+            }
+            
+            int currentIndex = nodes.push(SearchNode(current.parent, current.move));
+            
+            CorralResult corral = analyzeCorrals(boxes, normalized, pushList);
+            if (corral == CORRAL_DEADLOCK) {
+                corralPrunes++;
+                continue;
+            }
+            // A corral restriction has to be followed whole, so boxes in
+            // packed goal rooms are only left alone otherwise.
+            BoxSet packed;
+            if (corral == CORRAL_NONE) {
+                collectPushes(boxes, reachable, pushList);
+                if (macroMoves) {
+                    context.packedRoomBoxes(boxes, packed);
+                }
+            }
+            matching.assign(context, boxes);
+            
+            for (const PushMove& push : pushList) {
+                if (packed.test(push.box)) {
+                    continue;
+                }
+                expandMove(boxes, push, macroPushes);
+                int box = push.box;
+                int player = macroPushes.back().box;
+                int to = context.neighbour(player, macroPushes.back().dir);
+                
+                SolverState nextState = current;
+                nextState.packed.boxes.reset(box);
+                nextState.packed.boxes.set(to);
+                if (context.isFreezeDeadlock(nextState.packed.boxes, to)) {
+                    continue;
+                }
+                if (patterns && patterns->matches(nextState.packed.boxes, to, player)) {
+                    patternPrunes++;
+                    continue;
+                }
+                nextState.packed.player = player;
+                nextState.parent = currentIndex;
+                nextState.move = encodePushMove(push);
+                nextState.g += macroPushes.size();
+                hashPlayerMove(nextState, normalized, player);
+                hashBoxMove(nextState, box, to);
+                macroChildren += macroPushes.size() > 1;
+                
+                nextState.h = pushHeuristic(box, to);
+                if (nextState.h < DEADLOCK) {
+                    pushOpen(nextState);
+                }
+            }
+        }
+        
+        executionTimeMs = solverClockMs() - startTime;
+        return "";
+    }
+
+public:
+    AdvancedSolver(SolverMode mode = SOLVER_MODE_PUSHES)
+        : contextReady(false), mode(mode), macroMoves(false), corralStamp(0), corralVisitedCount(0), corralVerdictMask(0), corralVerdictCount(0), corralAge(0), patterns(nullptr), nodes(arena), openStates(arena), nodesExplored(0),
+          maxQueueSize(0), hashCollisions(0), corralPrunes(0), patternPrunes(0), patternsLearned(0), macroChildren(0), limitReached(false), timedOut(false), cancelled(false),
+          lastH(INT_MAX), control(nullptr), memoryBudgetMb(DEFAULT_MEMORY_MB), timeLimitMs(DEFAULT_TIME_LIMIT_MS), nodeLimit(0), arenaBytesReserved(0), arenaBytesUsed(0), peakBytes(0), executionTimeMs(0) {}
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        nodesExplored = 0;
+        maxQueueSize = 0;
+        hashCollisions = 0;
+        corralPrunes = 0;
+        patternPrunes = 0;
+        patternsLearned = 0;
+        macroChildren = 0;
+        limitReached = false;
+        timedOut = false;
+        cancelled = false;
+        lastH = INT_MAX;
+        progress.attach(control);
+        
+        if (closedTable.allocated()) {
+            closedTable.newAge();
+        } else {
+            closedTable.allocate((memoryBudgetMb << 20) / CLOSED_TABLE_SHARE,
+                                 (memoryBudgetMb << 20) / CLOSED_BLOOM_SHARE);
+        }
+        newCorralAge();
+        
+        std::string solution;
+        if (mode == SOLVER_MODE_PUSHES) {
+            solution = solvePushes(level, playerX, playerY);
+        } else {
+            solution = solveSteps(level, playerX, playerY);
+        }
+        
+        arenaBytesReserved = arena.bytesReserved();
+        arenaBytesUsed = arena.bytesUsed();
+        peakBytes = arenaBytesUsed + closedTable.bytesUsed() + corralVerdictCount * sizeof(CorralVerdict);
+        nodes.clear();
+        openStates.clear();
+        freeSlots.clear();
+        openSet.clear();
+        arena.release();
+        progress.finish();
+        contextReady = false;
+        return solution;
+    }
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    // Takes effect at the next solve; the closed table is sized from it.
+    void setMemoryBudgetMb(size_t budget) {
+        memoryBudgetMb = budget;
+        closedTable.release();
+        std::vector<CorralVerdict>().swap(corralVerdicts);
+    }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Stops after about `limit` expansions, whatever the machine's speed;
+    // 0 means no limit.
+    void setNodeLimit(int limit) { nodeLimit = limit; }
+    
+    // Progress goes to `shared`, which may also cancel the search; null
+    // detaches it.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to prune pushes with; corral deadlocks the search
+    // proves are added to them. Null turns both off.
+    void setPatterns(DeadlockPatterns* table) { patterns = table; }
+    
+    // Push mode only: pushes a box on through tunnels and into goal rooms
+    // as one move costing all of its pushes. Far fewer nodes on corridor
+    // levels, but the solution is no longer sure to have the fewest pushes.
+    void setMacroMoves(bool enabled) { macroMoves = enabled; }
+    
+    void setMode(SolverMode newMode) { mode = newMode; }
+    SolverMode getMode() const { return mode; }
+    
     int getNodesExplored() const { return nodesExplored; }
     int getMaxQueueSize() const { return maxQueueSize; }
+    int getHashCollisions() const { return hashCollisions; }
+    int getCorralPrunes() const { return corralPrunes; }
+    int getPatternPrunes() const { return patternPrunes; }
+    int getPatternsLearned() const { return patternsLearned; }
+    int getMacroChildren() const { return macroChildren; }
+    bool isLimitReached() const { return limitReached; }
+    bool isTimedOut() const { return timedOut; }
+    bool isCancelled() const { return cancelled; }
+    size_t getClosedEvictions() const { return closedTable.getEvictions(); }
+    size_t getArenaBytesReserved() const { return arenaBytesReserved; }
+    size_t getArenaBytesUsed() const { return arenaBytesUsed; }
+    // Memory the last solve actually used: the node and open tables in the
+    // arena plus the closed entries it stored.
+    size_t getPeakBytes() const { return peakBytes; }
     long long getExecutionTimeMs() const { return executionTimeMs; }
 };
-
-std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize);
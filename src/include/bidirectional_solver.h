@@ -0,0 +1,476 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "solver_arena.h"
+#include "solver_queue.h"
+#include "box_matching.h"
+#include "transposition_table.h"
+#include "advanced_solver.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
+
+// Push search from both ends. The forward side pushes boxes from the start
+// position towards the targets; the backward side pulls boxes off the
+// targets, starting once for every player zone of the solved position,
+// towards the start boxes. States of both sides are keyed the same way (box
+// Zobrist key plus the lowest cell of the player region), so a state
+// expanded on one side that the other side has already expanded joins the
+// two halves. The joined push sequence is replayed from the start and only
+// returned if it is legal and solves the level. The first meeting is
+// returned, which is not always the fewest pushes.
+//
+// The backward side needs as many boxes as targets; otherwise only the
+// forward side runs.
+//
+// As in A*, a quarter of the memory budget goes to the closed tables, split
+// between the two sides, and the node and open tables may use the rest.
+class BidirectionalSolver {
+public:
+    static const size_t DEFAULT_MEMORY_MB = 512;
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    static const size_t CLOSED_TABLE_SHARE = 4;
+    
+    BidirectionalSolver()
+        : contextReady(false), forward(arena), backward(arena), memoryBudgetMb(DEFAULT_MEMORY_MB),
+          timeLimitMs(DEFAULT_TIME_LIMIT_MS), nodeLimit(0), nodesExplored(0), maxQueueSize(0), limitReached(false),
+          timedOut(false), cancelled(false), lastH(INT_MAX), control(nullptr), patterns(nullptr), peakBytes(0), executionTimeMs(0) {}
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    void setMemoryBudgetMb(size_t budget) { memoryBudgetMb = std::max<size_t>(1, budget); }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Stops after about `limit` expansions over both sides; 0 means no
+    // limit.
+    void setNodeLimit(int limit) { nodeLimit = limit; }
+    
+    // Progress goes to `shared`, which may also cancel the search.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to prune pushes with, or null. Only read.
+    void setPatterns(const DeadlockPatterns* table) { patterns = table; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        long long startTime = solverClockMs();
+        nodesExplored = 0;
+        maxQueueSize = 0;
+        limitReached = false;
+        timedOut = false;
+        cancelled = false;
+        lastH = INT_MAX;
+        progress.attach(control);
+        forward.closed.allocate((memoryBudgetMb << 20) / CLOSED_TABLE_SHARE / 2);
+        backward.closed.allocate((memoryBudgetMb << 20) / CLOSED_TABLE_SHARE / 2);
+        
+        std::string solution = run(level, playerX, playerY, startTime);
+        
+        progress.finish();
+        peakBytes = arena.bytesUsed() + forward.closed.bytesUsed() + backward.closed.bytesUsed();
+        forward.clear();
+        backward.clear();
+        arena.release();
+        contextReady = false;
+        executionTimeMs = solverClockMs() - startTime;
+        return solution;
+    }
+    
+    int getNodesExplored() const { return nodesExplored; }
+    int getForwardNodes() const { return forward.expanded; }
+    int getBackwardNodes() const { return backward.expanded; }
+    int getMaxQueueSize() const { return maxQueueSize; }
+    // Ran out of memory; running out of time or nodes sets isTimedOut.
+    bool isLimitReached() const { return limitReached; }
+    bool isTimedOut() const { return timedOut; }
+    bool isCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+    // What the arena and both closed tables held when the last solve ended.
+    size_t getPeakBytes() const { return peakBytes; }
+
+private:
+    // One search direction: its open and closed lists, its node table and
+    // the distance table its heuristic matches boxes against.
+    struct Side {
+        ArenaTable<SearchNode> nodes;
+        ArenaTable<SolverState> openStates;
+        std::vector<int> freeSlots;
+        BucketQueue open;
+        StateNodeTable closed;
+        const std::vector<uint16_t>* distances;
+        int columns;
+        int expanded;
+        
+        explicit Side(SolverArena& arena)
+            : nodes(arena), openStates(arena), distances(nullptr), columns(0), expanded(0) {}
+        
+        void clear() {
+            nodes.clear();
+            openStates.clear();
+            freeSlots.clear();
+            open.clear();
+            closed.release();
+        }
+    };
+    
+    SolverContext context;
+    bool contextReady;
+    std::vector<uint16_t> startDistances;
+    
+    SolverArena arena;
+    Side forward;
+    Side backward;
+    BoxMatching matching;
+    BoxMatching childMatching;
+    std::vector<char> reachable;
+    std::vector<int> cellStack;
+    
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    int nodeLimit;
+    int nodesExplored;
+    int maxQueueSize;
+    bool limitReached;
+    bool timedOut;
+    bool cancelled;
+    int lastH;
+    ProgressReporter progress;
+    SolverControl* control;
+    const DeadlockPatterns* patterns;
+    size_t peakBytes;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY, long long startTime) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "Bidirectional: level has no usable floor or more than "
+                      << MAX_FLOOR_CELLS << " floor cells" << std::endl;
+            return "";
+        }
+        
+        PackedState start;
+        if (!context.packState(level, playerX, playerY, start)) {
+            std::cout << "Bidirectional: box or player outside the playable floor" << std::endl;
+            return "";
+        }
+        if (start.boxes.count() == 0 || context.targetCells.empty()) {
+            return "";
+        }
+        
+        forward.expanded = 0;
+        backward.expanded = 0;
+        forward.distances = &context.pushDistances;
+        forward.columns = context.targetCells.size();
+        
+        SolverState root;
+        root.packed = start;
+        if (!seed(forward, root)) {
+            return "";
+        }
+        
+        if (start.boxes.count() == context.targets.count()) {
+            std::vector<int> startCells;
+            for (int box = start.boxes.next(0); box >= 0; box = start.boxes.next(box + 1)) {
+                startCells.push_back(box);
+            }
+            context.computePushDistancesFrom(startCells, startDistances);
+            backward.distances = &startDistances;
+            backward.columns = startCells.size();
+            seedGoals();
+        } else {
+            std::cout << "Bidirectional: box and target counts differ, searching forward only" << std::endl;
+        }
+        
+        SolverState current;
+        while (!budgetExceeded(startTime)) {
+            maxQueueSize = std::max(maxQueueSize, (int)(forward.open.size() + backward.open.size()));
+            
+            bool useForward = backward.open.empty() ||
+                              (!forward.open.empty() && forward.open.size() <= backward.open.size());
+            Side& side = useForward ? forward : backward;
+            Side& other = useForward ? backward : forward;
+            if (!popOpen(side, current)) {
+                return "";
+            }
+            lastH = current.h;
+            
+            int node = close(side, current);
+            if (node < 0) {
+                continue;
+            }
+            nodesExplored++;
+            side.expanded++;
+            
+            if (useForward && current.packed.boxes.isSubsetOf(context.targets)) {
+                return stitch(start, node, -1);
+            }
+            
+            int met = other.closed.find(current.hash, current.hashCheck);
+            if (met >= 0) {
+                return useForward ? stitch(start, node, met) : stitch(start, met, node);
+            }
+            
+            if (useForward) {
+                expandPushes(current, node);
+            } else {
+                expandPulls(current, node);
+            }
+        }
+        
+        return "";
+    }
+    
+    // Running out of memory sets limitReached, running out of time or of
+    // the node limit sets timedOut. The same poll reports progress and
+    // notices a cancel request.
+    bool budgetExceeded(long long startTime) {
+        if (arena.bytesReserved() + forward.closed.bytes() + backward.closed.bytes() > memoryBudgetMb << 20) {
+            limitReached = true;
+            return true;
+        }
+        if ((nodesExplored & 1023) != 0) {
+            return false;
+        }
+        progress.report(nodesExplored, forward.open.size() + backward.open.size(), lastH);
+        if (progress.cancelled()) {
+            cancelled = true;
+            return true;
+        }
+        if ((int)(solverClockMs() - startTime) >= timeLimitMs || (nodeLimit > 0 && nodesExplored >= nodeLimit)) {
+            timedOut = true;
+            return true;
+        }
+        return false;
+    }
+    
+    // Hashes a root state and queues it; false if its heuristic already
+    // shows a deadlock.
+    bool seed(Side& side, SolverState& state) {
+        const ZobristTable& zobrist = context.zobrist;
+        state.hash = zobrist.playerKeys[state.packed.player];
+        state.hashCheck = zobrist.playerCheckKeys[state.packed.player];
+        const BoxSet& boxes = state.packed.boxes;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            state.hash ^= zobrist.boxKeys[box];
+            state.hashCheck ^= zobrist.boxCheckKeys[box];
+        }
+        
+        matching.assign(*side.distances, side.columns, context.floorCount, boxes);
+        state.h = matching.cost();
+        if (state.h >= BoxMatching::INFINITE_COST) {
+            return false;
+        }
+        pushOpen(side, state);
+        return true;
+    }
+    
+    // The solved position has every box on a target. The player may end up
+    // in any zone the boxes leave open, so each zone is a root of its own.
+    void seedGoals() {
+        std::vector<char> zoned(context.floorCount, 0);
+        for (int cell = 0; cell < context.floorCount; cell++) {
+            if (zoned[cell] || context.isTarget(cell)) continue;
+            
+            computeReachable(context.targets, cell);
+            for (int other = 0; other < context.floorCount; other++) {
+                zoned[other] = zoned[other] || reachable[other];
+            }
+            
+            SolverState goal;
+            goal.packed.boxes = context.targets;
+            goal.packed.player = cell;
+            seed(backward, goal);
+        }
+    }
+    
+    void pushOpen(Side& side, const SolverState& state) {
+        int slot;
+        if (side.freeSlots.empty()) {
+            slot = side.openStates.push(state);
+        } else {
+            slot = side.freeSlots.back();
+            side.freeSlots.pop_back();
+            side.openStates[slot] = state;
+        }
+        side.open.push(slot, state.f(), state.h);
+    }
+    
+    bool popOpen(Side& side, SolverState& state) {
+        int slot = side.open.pop();
+        if (slot < 0) {
+            return false;
+        }
+        state = side.openStates[slot];
+        side.freeSlots.push_back(slot);
+        return true;
+    }
+    
+    // Normalizes the player, leaving its region in `reachable`, and records
+    // the state as expanded. Returns its node index, or -1 if it already was.
+    int close(Side& side, SolverState& state) {
+        int normalized = computeReachable(state.packed.boxes, state.packed.player);
+        const ZobristTable& zobrist = context.zobrist;
+        state.hash ^= zobrist.playerKeys[state.packed.player] ^ zobrist.playerKeys[normalized];
+        state.hashCheck ^= zobrist.playerCheckKeys[state.packed.player] ^ zobrist.playerCheckKeys[normalized];
+        state.packed.player = normalized;
+        
+        if (side.closed.find(state.hash, state.hashCheck) >= 0) {
+            return -1;
+        }
+        
+        int node = side.nodes.push(SearchNode(state.parent, state.move));
+        side.closed.insert(state.hash, state.hashCheck, node);
+        return node;
+    }
+    
+    int computeReachable(const BoxSet& boxes, int start) {
+        reachable.assign(context.floorCount, 0);
+        cellStack.assign(1, start);
+        reachable[start] = 1;
+        int normalized = start;
+        
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            normalized = std::min(normalized, cell);
+            
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context.neighbour(cell, dir);
+                if (next >= 0 && !reachable[next] && !boxes.test(next)) {
+                    reachable[next] = 1;
+                    cellStack.push_back(next);
+                }
+            }
+        }
+        
+        return normalized;
+    }
+    
+    // Queues a child that moved one box from `from` to `to` and left the
+    // player on `player`, scored against the side's distance table.
+    void pushChild(Side& side, const SolverState& parent, int node, uint32_t move, int from, int to, int player) {
+        childMatching = matching;
+        childMatching.moveBox(from, to);
+        
+        SolverState next = parent;
+        next.h = childMatching.cost();
+        if (next.h >= BoxMatching::INFINITE_COST) {
+            return;
+        }
+        
+        const ZobristTable& zobrist = context.zobrist;
+        next.packed.boxes.reset(from);
+        next.packed.boxes.set(to);
+        next.hash ^= zobrist.playerKeys[parent.packed.player] ^ zobrist.playerKeys[player];
+        next.hashCheck ^= zobrist.playerCheckKeys[parent.packed.player] ^ zobrist.playerCheckKeys[player];
+        next.hash ^= zobrist.boxKeys[from] ^ zobrist.boxKeys[to];
+        next.hashCheck ^= zobrist.boxCheckKeys[from] ^ zobrist.boxCheckKeys[to];
+        next.packed.player = player;
+        next.parent = node;
+        next.move = move;
+        next.g += 1;
+        pushOpen(side, next);
+    }
+    
+    void expandPushes(const SolverState& current, int node) {
+        const BoxSet& boxes = current.packed.boxes;
+        matching.assign(*forward.distances, forward.columns, context.floorCount, boxes);
+        
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int from = context.neighbour(box, (dir + 2) % 4);
+                int to = context.neighbour(box, dir);
+                if (from < 0 || !reachable[from] || to < 0 || boxes.test(to) || context.isDead(to)) {
+                    continue;
+                }
+                
+                BoxSet moved = boxes;
+                moved.reset(box);
+                moved.set(to);
+                if (context.isFreezeDeadlock(moved, to) || (patterns && patterns->matches(moved, to, box))) {
+                    continue;
+                }
+                pushChild(forward, current, node, encodePushMove(PushMove(box, dir)), box, to, box);
+            }
+        }
+    }
+    
+    // A pull in direction dir moves the box onto the player's cell and the
+    // player one step further; it is stored as PushMove(box, dir) with the
+    // box's cell before the pull.
+    void expandPulls(const SolverState& current, int node) {
+        const BoxSet& boxes = current.packed.boxes;
+        matching.assign(*backward.distances, backward.columns, context.floorCount, boxes);
+        
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int to = context.neighbour(box, dir);
+                if (to < 0 || !reachable[to]) continue;
+                int player = context.neighbour(to, dir);
+                if (player < 0 || boxes.test(player)) continue;
+                pushChild(backward, current, node, encodePushMove(PushMove(box, dir)), box, to, player);
+            }
+        }
+    }
+    
+    // Move codes from a side's root down to `node`.
+    std::vector<uint32_t> collectMoves(const Side& side, int node) {
+        std::vector<uint32_t> moves;
+        for (int index = node; index >= 0 && side.nodes[index].parent >= 0; index = side.nodes[index].parent) {
+            moves.push_back(side.nodes[index].move);
+        }
+        std::reverse(moves.begin(), moves.end());
+        return moves;
+    }
+    
+    // Forward pushes up to the meeting state, then the backward pulls undone
+    // in reverse order, replayed from the start with walks filled in.
+    std::string stitch(const PackedState& start, int forwardNode, int backwardNode) {
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        std::vector<PushMove> pushes;
+        for (uint32_t move : collectMoves(forward, forwardNode)) {
+            pushes.push_back(decodePushMove(move));
+        }
+        if (backwardNode >= 0) {
+            std::vector<uint32_t> pulls = collectMoves(backward, backwardNode);
+            for (auto it = pulls.rbegin(); it != pulls.rend(); ++it) {
+                PushMove pull = decodePushMove(*it);
+                pushes.push_back(PushMove(context.neighbour(pull.box, pull.dir), (pull.dir + 2) % 4));
+            }
+        }
+        
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        std::string path;
+        std::string walk;
+        for (const PushMove& push : pushes) {
+            int pushFrom = context.neighbour(push.box, (push.dir + 2) % 4);
+            int to = context.neighbour(push.box, push.dir);
+            if (!boxes.test(push.box) || pushFrom < 0 || to < 0 || boxes.test(to) ||
+                !context.findWalk(boxes, player, pushFrom, walk)) {
+                std::cout << "Bidirectional: joined solution is not a legal push sequence" << std::endl;
+                return "";
+            }
+            path += walk;
+            path += dirChars[push.dir];
+            
+            boxes.reset(push.box);
+            boxes.set(to);
+            player = push.box;
+        }
+        
+        if (!boxes.isSubsetOf(context.targets)) {
+            std::cout << "Bidirectional: joined solution does not solve the level" << std::endl;
+            return "";
+        }
+        return path;
+    }
+};
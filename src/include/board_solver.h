@@ -0,0 +1,490 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <queue>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_control.h"
+
+// Push search for levels whose floor is too large for SolverContext. States
+// are sorted lists of board indices (y * width + x) rather than bitsets, so
+// there is no cap on the floor, but none of the context's tables are there
+// either: only dead squares prune, and the heuristic adds up each box's
+// pushes to its nearest target. That sum is weighted up in the open-list
+// order, so the solution does not always have the fewest pushes.
+//
+// Nodes, box lists and the open and closed lists all count towards the
+// memory budget; the deques grow in fixed blocks, so they never overshoot
+// it by a doubling.
+class BoardSolver {
+public:
+    static const size_t DEFAULT_MEMORY_MB = 512;
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    
+    BoardSolver()
+        : width(0), boxCount(0), memoryBudgetMb(DEFAULT_MEMORY_MB), timeLimitMs(DEFAULT_TIME_LIMIT_MS), nodesExplored(0),
+          maxQueueSize(0), limitReached(false), timedOut(false), cancelled(false), lastH(INT_MAX), control(nullptr),
+          peakBytes(0), executionTimeMs(0) {}
+    
+    void setMemoryBudgetMb(size_t budget) { memoryBudgetMb = std::max<size_t>(1, budget); }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Progress goes to `shared`, which may also cancel the search.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        long long startTime = solverClockMs();
+        nodesExplored = 0;
+        maxQueueSize = 0;
+        limitReached = false;
+        timedOut = false;
+        cancelled = false;
+        lastH = INT_MAX;
+        progress.attach(control);
+        
+        std::string solution = run(level, playerX, playerY, startTime);
+        
+        progress.finish();
+        peakBytes = bytesUsed();
+        nodes.clear();
+        boxPool.clear();
+        closed.clear();
+        open = OpenQueue();
+        executionTimeMs = solverClockMs() - startTime;
+        return solution;
+    }
+    
+    int getNodesExplored() const { return nodesExplored; }
+    int getMaxQueueSize() const { return maxQueueSize; }
+    // Ran out of memory; running out of time sets isTimedOut.
+    bool isLimitReached() const { return limitReached; }
+    bool isTimedOut() const { return timedOut; }
+    bool isCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+    // What the search held when the last solve ended.
+    size_t getPeakBytes() const { return peakBytes; }
+
+private:
+    static constexpr int UNREACHABLE = INT_MAX;
+    // Weight on the heuristic in the open-list order: larger levels are
+    // only worth a solution found in time, not the shortest one.
+    static const int HEURISTIC_WEIGHT = 2;
+    // Rough cost of one closed-list entry: the pair plus the hash node.
+    static const size_t CLOSED_ENTRY_BYTES = 48;
+    
+    // A pushed state. Its boxes are boxCount sorted board indices in
+    // boxPool from index * boxCount; `player` is where the push left the
+    // player, and the lowest cell of its region once the node is expanded;
+    // `hash` keys the boxes only; `move` is box * 4 + dir of the push that
+    // led here.
+    struct Node {
+        int parent;
+        int player;
+        int g;
+        int move;
+        uint64_t hash;
+    };
+    
+    struct OpenEntry {
+        int f;
+        int h;
+        int node;
+        
+        bool operator>(const OpenEntry& other) const {
+            return f != other.f ? f > other.f : h > other.h;
+        }
+    };
+    
+    typedef std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> OpenQueue;
+    
+    int width;
+    int boxCount;
+    int directions[4];
+    std::vector<char> floor;
+    std::vector<char> target;
+    std::vector<int> targetCells;
+    std::vector<int> distance;       // board index -> pushes of a lone box to its nearest target
+    std::vector<int> targetDistance; // target * board size + board index -> pushes to that target
+    std::vector<char> boxMatched;
+    std::vector<char> targetMatched;
+    std::vector<uint64_t> boxKeys;
+    std::vector<uint64_t> playerKeys;
+    std::deque<Node> nodes;
+    std::deque<int> boxPool;
+    std::unordered_multimap<uint64_t, int> closed;
+    OpenQueue open;
+    std::vector<char> occupied;
+    std::vector<char> region;
+    std::vector<int> cellStack;
+    std::vector<int> boxes;
+    std::vector<int> childBoxes;
+    
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    ProgressReporter progress;
+    int nodesExplored;
+    int maxQueueSize;
+    bool limitReached;
+    bool timedOut;
+    bool cancelled;
+    int lastH;
+    SolverControl* control;
+    size_t peakBytes;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY, long long startTime) {
+        if (!buildBoard(level, playerX, playerY)) {
+            return "";
+        }
+        
+        boxes.clear();
+        for (int index = 0; index < (int)floor.size(); index++) {
+            TileType tile = level.currentMap[index / width][index % width];
+            if (tile == BOX || tile == BOX_ON_TARGET) {
+                if (!floor[index]) {
+                    return "";
+                }
+                boxes.push_back(index);
+            }
+        }
+        boxCount = boxes.size();
+        if (boxCount == 0) {
+            return "";
+        }
+        
+        int start = playerY * width + playerX;
+        Node root;
+        root.parent = -1;
+        root.player = start;
+        root.g = 0;
+        root.move = -1;
+        root.hash = boxesHash(boxes);
+        int h = heuristic(boxes);
+        if (h == UNREACHABLE) {
+            return "";
+        }
+        addNode(root, boxes);
+        open.push(OpenEntry{h, h, 0});
+        
+        while (!open.empty()) {
+            if (budgetExceeded(startTime)) {
+                return "";
+            }
+            OpenEntry entry = open.top();
+            open.pop();
+            
+            loadBoxes(entry.node, boxes);
+            if (entry.h == 0) {
+                return rebuildPath(start, entry.node);
+            }
+            Node& node = nodes[entry.node];
+            node.player = fillRegion(boxes, node.player);
+            if (!closeState(entry.node, boxes)) {
+                clearOccupied(boxes);
+                continue;
+            }
+            nodesExplored++;
+            lastH = std::min(lastH, entry.h);
+            
+            for (int i = 0; i < boxCount; i++) {
+                for (int dir = 0; dir < 4; dir++) {
+                    int box = boxes[i];
+                    int from = box - directions[dir];
+                    int to = box + directions[dir];
+                    if (!region[from] || !floor[to] || occupied[to] || distance[to] == UNREACHABLE) {
+                        continue;
+                    }
+                    
+                    childBoxes = boxes;
+                    childBoxes[i] = to;
+                    std::sort(childBoxes.begin(), childBoxes.end());
+                    Node child;
+                    child.parent = entry.node;
+                    child.g = node.g + 1;
+                    child.move = box * 4 + dir;
+                    child.player = box;
+                    child.hash = node.hash ^ boxKeys[box] ^ boxKeys[to];
+                    int childH = heuristic(childBoxes);
+                    addNode(child, childBoxes);
+                    open.push(OpenEntry{child.g + HEURISTIC_WEIGHT * childH, childH, (int)nodes.size() - 1});
+                }
+            }
+            clearOccupied(boxes);
+            maxQueueSize = std::max(maxQueueSize, (int)open.size());
+        }
+        
+        return "";
+    }
+    
+    // The floor is whatever the player could walk to on an empty board;
+    // anything else counts as wall. Then pulls a box back from every target
+    // to find how many pushes each cell is from the nearest one.
+    bool buildBoard(const Level& level, int playerX, int playerY) {
+        width = level.width;
+        int size = level.width * level.height;
+        directions[0] = -width;
+        directions[1] = 1;
+        directions[2] = width;
+        directions[3] = -1;
+        floor.assign(size, 0);
+        target.assign(size, 0);
+        occupied.assign(size, 0);
+        if (playerX < 0 || playerY < 0 || playerX >= level.width || playerY >= level.height ||
+            level.originalMap[playerY][playerX] == WALL) {
+            return false;
+        }
+        
+        // Border cells keep their outward neighbours off the floor, so no
+        // index below ever wraps around a row or leaves the board.
+        cellStack.assign(1, playerY * width + playerX);
+        floor[cellStack[0]] = 1;
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            int x = cell % width, y = cell / width;
+            if (x == 0 || y == 0 || x == width - 1 || y == level.height - 1) {
+                return false;
+            }
+            for (int dir = 0; dir < 4; dir++) {
+                int next = cell + directions[dir];
+                if (!floor[next] && level.originalMap[next / width][next % width] != WALL) {
+                    floor[next] = 1;
+                    cellStack.push_back(next);
+                }
+            }
+        }
+        
+        targetCells.clear();
+        for (int cell = 0; cell < size; cell++) {
+            TileType tile = level.originalMap[cell / width][cell % width];
+            if (floor[cell] && (tile == TARGET || tile == BOX_ON_TARGET)) {
+                target[cell] = 1;
+                targetCells.push_back(cell);
+            }
+        }
+        
+        distance.assign(size, UNREACHABLE);
+        targetDistance.assign(targetCells.size() * size, UNREACHABLE);
+        std::vector<int> queue;
+        for (size_t t = 0; t < targetCells.size(); t++) {
+            int* pushes = &targetDistance[t * size];
+            pushes[targetCells[t]] = 0;
+            queue.assign(1, targetCells[t]);
+            for (size_t head = 0; head < queue.size(); head++) {
+                int cell = queue[head];
+                distance[cell] = std::min(distance[cell], pushes[cell]);
+                for (int dir = 0; dir < 4; dir++) {
+                    int from = cell - directions[dir];
+                    if (floor[from] && floor[from - directions[dir]] && pushes[from] == UNREACHABLE) {
+                        pushes[from] = pushes[cell] + 1;
+                        queue.push_back(from);
+                    }
+                }
+            }
+        }
+        
+        std::mt19937_64 random(0x5eed50c0ba11ULL);
+        boxKeys.resize(size);
+        playerKeys.resize(size);
+        for (int cell = 0; cell < size; cell++) {
+            boxKeys[cell] = random();
+            playerKeys[cell] = random();
+        }
+        return !targetCells.empty();
+    }
+    
+    uint64_t boxesHash(const std::vector<int>& list) const {
+        uint64_t hash = 0;
+        for (int box : list) {
+            hash ^= boxKeys[box];
+        }
+        return hash;
+    }
+    
+    // Pushes to the targets with boxes and targets matched greedily, the
+    // closest free pair first. Boxes left with no free target they can
+    // reach count their nearest one. UNREACHABLE if a box is on a dead
+    // square.
+    int heuristic(const std::vector<int>& list) {
+        int h = 0;
+        for (int box : list) {
+            if (distance[box] == UNREACHABLE) {
+                return UNREACHABLE;
+            }
+        }
+        
+        size_t size = floor.size();
+        boxMatched.assign(list.size(), 0);
+        targetMatched.assign(targetCells.size(), 0);
+        for (size_t round = 0; round < list.size(); round++) {
+            int best = UNREACHABLE, bestBox = -1, bestTarget = -1;
+            for (size_t b = 0; b < list.size(); b++) {
+                if (boxMatched[b]) continue;
+                for (size_t t = 0; t < targetCells.size(); t++) {
+                    int pushes = targetDistance[t * size + list[b]];
+                    if (!targetMatched[t] && pushes < best) {
+                        best = pushes;
+                        bestBox = b;
+                        bestTarget = t;
+                    }
+                }
+            }
+            if (bestBox < 0) {
+                break;
+            }
+            h += best;
+            boxMatched[bestBox] = 1;
+            targetMatched[bestTarget] = 1;
+        }
+        for (size_t b = 0; b < list.size(); b++) {
+            if (!boxMatched[b]) {
+                h += distance[list[b]];
+            }
+        }
+        return h;
+    }
+    
+    // Marks the boxes in `occupied` and the player's region in `region`,
+    // and returns the region's lowest index. The boxes stay marked.
+    int fillRegion(const std::vector<int>& list, int start) {
+        for (int box : list) {
+            occupied[box] = 1;
+        }
+        region.assign(floor.size(), 0);
+        region[start] = 1;
+        cellStack.assign(1, start);
+        int lowest = start;
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            lowest = std::min(lowest, cell);
+            for (int dir = 0; dir < 4; dir++) {
+                int next = cell + directions[dir];
+                if (floor[next] && !occupied[next] && !region[next]) {
+                    region[next] = 1;
+                    cellStack.push_back(next);
+                }
+            }
+        }
+        return lowest;
+    }
+    
+    void clearOccupied(const std::vector<int>& list) {
+        for (int box : list) {
+            occupied[box] = 0;
+        }
+    }
+    
+    void loadBoxes(int node, std::vector<int>& list) const {
+        auto first = boxPool.begin() + (size_t)node * boxCount;
+        list.assign(first, first + boxCount);
+    }
+    
+    void addNode(const Node& node, const std::vector<int>& list) {
+        nodes.push_back(node);
+        boxPool.insert(boxPool.end(), list.begin(), list.end());
+    }
+    
+    // Closes the state of node `index`, whose player is already the lowest
+    // cell of its region. False if a state with the same boxes and region
+    // was closed before; the box lists are compared whenever keys match.
+    bool closeState(int index, const std::vector<int>& list) {
+        const Node& node = nodes[index];
+        uint64_t key = node.hash ^ playerKeys[node.player];
+        auto range = closed.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (nodes[it->second].player != node.player) {
+                continue;
+            }
+            auto first = boxPool.begin() + (size_t)it->second * boxCount;
+            if (std::equal(list.begin(), list.end(), first)) {
+                return false;
+            }
+        }
+        closed.emplace(key, index);
+        return true;
+    }
+    
+    size_t bytesUsed() const {
+        return nodes.size() * sizeof(Node) + boxPool.size() * sizeof(int) + closed.size() * CLOSED_ENTRY_BYTES +
+               open.size() * sizeof(OpenEntry);
+    }
+    
+    // As in AdvancedSolver: memory on every node, the rest every 1024.
+    bool budgetExceeded(long long startTime) {
+        if (bytesUsed() > memoryBudgetMb << 20) {
+            limitReached = true;
+            return true;
+        }
+        if ((nodesExplored & 1023) != 0) {
+            return false;
+        }
+        progress.report(nodesExplored, open.size(), lastH);
+        if (progress.cancelled()) {
+            cancelled = true;
+            return true;
+        }
+        if (solverClockMs() - startTime >= timeLimitMs) {
+            timedOut = true;
+            return true;
+        }
+        return false;
+    }
+    
+    // Replays the pushes from the start, walking the player to each one.
+    std::string rebuildPath(int start, int goal) {
+        std::vector<int> moves;
+        for (int node = goal; nodes[node].parent >= 0; node = nodes[node].parent) {
+            moves.push_back(nodes[node].move);
+        }
+        std::reverse(moves.begin(), moves.end());
+        
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        loadBoxes(0, boxes);
+        std::fill(occupied.begin(), occupied.end(), 0);
+        for (int box : boxes) {
+            occupied[box] = 1;
+        }
+        int player = start;
+        std::string path;
+        std::vector<int> cameFrom(floor.size());
+        for (int move : moves) {
+            int box = move / 4, dir = move % 4;
+            int pushFrom = box - directions[dir];
+            
+            std::fill(cameFrom.begin(), cameFrom.end(), -1);
+            cameFrom[player] = 4;
+            std::vector<int> queue(1, player);
+            for (size_t head = 0; head < queue.size() && cameFrom[pushFrom] < 0; head++) {
+                for (int step = 0; step < 4; step++) {
+                    int next = queue[head] + directions[step];
+                    if (floor[next] && !occupied[next] && cameFrom[next] < 0) {
+                        cameFrom[next] = step;
+                        queue.push_back(next);
+                    }
+                }
+            }
+            if (cameFrom[pushFrom] < 0) {
+                return "";
+            }
+            std::string walk;
+            for (int cell = pushFrom; cell != player; cell -= directions[cameFrom[cell]]) {
+                walk += dirChars[cameFrom[cell]];
+            }
+            path.append(walk.rbegin(), walk.rend());
+            path += dirChars[dir];
+            
+            occupied[box] = 0;
+            occupied[box + directions[dir]] = 1;
+            player = box;
+        }
+        return path;
+    }
+};
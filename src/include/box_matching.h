@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include "solver_context.h"
+
+// Minimum-cost assignment of boxes to targets with the push distances of a
+// SolverContext as costs, solved by the Hungarian method with potentials.
+// Any other cell-to-column distance table with the same layout can stand in
+// for the push distances.
+// The total is a lower bound on the pushes left. After a push only the
+// moved box's row changes, so moveBox() repairs the assignment with a single
+// augmenting path instead of solving it again.
+// With fewer boxes than targets the matrix is padded with zero-cost rows up
+// to square: a target left free would otherwise keep a negative potential
+// after moveBox() frees it, and the repaired total could come out too high.
+class BoxMatching {
+public:
+    // Cost of a box that cannot reach a target at all.
+    static const int INFINITE_COST = 1000000;
+    
+    BoxMatching() : distances(nullptr), stride(0), rows(0), cols(0) {}
+    
+    void assign(const SolverContext& context, const BoxSet& boxes) {
+        assign(context.pushDistances, context.targetCells.size(), context.floorCount, boxes);
+    }
+    
+    // Costs come from `table`, laid out column * floorCount + cell, which
+    // must outlive the matching.
+    void assign(const std::vector<uint16_t>& table, int columns, int floorCount, const BoxSet& boxes) {
+        distances = table.data();
+        stride = floorCount;
+        rows = boxes.count();
+        cols = columns;
+        rowCell.assign(std::max(rows, cols) + 1, -1);
+        u.assign(std::max(rows, cols) + 1, 0);
+        v.assign(cols + 1, 0);
+        p.assign(cols + 1, 0);
+        way.assign(cols + 1, 0);
+        
+        if (rows > cols) {
+            return;
+        }
+        
+        int row = 1;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            rowCell[row++] = box;
+        }
+        for (row = 1; row <= cols; row++) {
+            augment(row);
+        }
+    }
+    
+    void moveBox(int fromCell, int toCell) {
+        if (rows > cols) {
+            return;
+        }
+        
+        int row = 1;
+        while (row <= rows && rowCell[row] != fromCell) {
+            row++;
+        }
+        if (row > rows) {
+            return;
+        }
+        
+        rowCell[row] = toCell;
+        for (int col = 1; col <= cols; col++) {
+            if (p[col] == row) {
+                p[col] = 0;
+            }
+        }
+        augment(row);
+    }
+    
+    // Total pushes of the assignment; INFINITE_COST or more means deadlock.
+    int cost() const {
+        if (rows > cols) {
+            return INFINITE_COST;
+        }
+        
+        int total = 0;
+        for (int col = 1; col <= cols; col++) {
+            if (p[col] != 0 && p[col] <= rows) {
+                total += edgeCost(p[col], col);
+            }
+        }
+        return total;
+    }
+
+private:
+    int edgeCost(int row, int col) const {
+        if (row > rows) {
+            return 0;
+        }
+        int distance = distances[(col - 1) * stride + rowCell[row]];
+        return distance == SolverContext::UNREACHABLE ? INFINITE_COST : distance;
+    }
+    
+    // Inserts `row` into the assignment along a shortest augmenting path,
+    // keeping the potentials of all other rows feasible.
+    void augment(int row) {
+        minCost.assign(cols + 1, INT_MAX);
+        used.assign(cols + 1, 0);
+        p[0] = row;
+        int col = 0;
+        
+        do {
+            used[col] = 1;
+            int current = p[col];
+            int delta = INT_MAX;
+            int nextCol = 0;
+            
+            for (int j = 1; j <= cols; j++) {
+                if (used[j]) continue;
+                int reduced = edgeCost(current, j) - u[current] - v[j];
+                if (reduced < minCost[j]) {
+                    minCost[j] = reduced;
+                    way[j] = col;
+                }
+                if (minCost[j] < delta) {
+                    delta = minCost[j];
+                    nextCol = j;
+                }
+            }
+            
+            for (int j = 0; j <= cols; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minCost[j] -= delta;
+                }
+            }
+            col = nextCol;
+        } while (p[col] != 0);
+        
+        do {
+            int previous = way[col];
+            p[col] = p[previous];
+            col = previous;
+        } while (col != 0);
+    }
+    
+    const uint16_t* distances;
+    int stride;
+    int rows;
+    int cols;
+    std::vector<int> rowCell;
+    std::vector<int> u;
+    std::vector<int> v;
+    std::vector<int> p;
+    std::vector<int> way;
+    std::vector<int> minCost;
+    std::vector<char> used;
+};
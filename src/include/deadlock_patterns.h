@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_context.h"
+
+// A box arrangement proven unsolvable while the player is outside the area
+// it fences off. Any state holding all of `boxes`, with the player on a
+// cell outside `area`, is lost too: more boxes only get in the way.
+struct DeadlockPattern {
+    BoxSet boxes;
+    BoxSet area;    // the fenced area and the pattern's own boxes
+};
+
+// Deadlock patterns learned for one level. Each pattern is listed under
+// every one of its boxes, so a push only looks at the few patterns that
+// hold the pushed box, with a subset test of a few words each.
+//
+// Not synchronized: a table is filled by one search at a time, though any
+// number may read it while none writes.
+class DeadlockPatterns {
+public:
+    // Larger patterns are rarely met again and are not kept.
+    static const int MAX_PATTERN_BOXES = 6;
+    static const size_t MAX_PATTERNS = 4096;
+    static const size_t MAX_PATTERNS_PER_CELL = 64;
+    
+    DeadlockPatterns() {}
+    
+    void clear() {
+        patterns.clear();
+        byCell.clear();
+    }
+    
+    // False if the pattern is too large, already known or finds no room.
+    bool add(const DeadlockPattern& pattern) {
+        int first = pattern.boxes.next(0);
+        if (first < 0 || pattern.boxes.count() > MAX_PATTERN_BOXES || patterns.size() >= MAX_PATTERNS) {
+            return false;
+        }
+        if (byCell.empty()) {
+            byCell.resize(MAX_FLOOR_CELLS);
+        }
+        // A known pattern with fewer boxes and no more area already
+        // matches every state this one would.
+        for (int box = first; box >= 0; box = pattern.boxes.next(box + 1)) {
+            if (byCell[box].size() >= MAX_PATTERNS_PER_CELL) {
+                return false;
+            }
+            for (int index : byCell[box]) {
+                if (patterns[index].boxes.isSubsetOf(pattern.boxes) && patterns[index].area.isSubsetOf(pattern.area)) {
+                    return false;
+                }
+            }
+        }
+        
+        for (int box = first; box >= 0; box = pattern.boxes.next(box + 1)) {
+            byCell[box].push_back(patterns.size());
+        }
+        patterns.push_back(pattern);
+        return true;
+    }
+    
+    // Run after a push onto `cell`, with the player on `player`: true if a
+    // pattern holding that box matches.
+    bool matches(const BoxSet& boxes, int cell, int player) const {
+        if (byCell.empty()) {
+            return false;
+        }
+        for (int index : byCell[cell]) {
+            const DeadlockPattern& pattern = patterns[index];
+            if (!pattern.area.test(player) && pattern.boxes.isSubsetOf(boxes)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    size_t size() const { return patterns.size(); }
+    const std::vector<DeadlockPattern>& all() const { return patterns; }
+
+private:
+    std::vector<DeadlockPattern> patterns;
+    std::vector<std::vector<int>> byCell;
+};
+
+// Patterns of every level, kept on disk between runs. Like the solution
+// cache they are keyed by the layout hash, and cells are stored as board
+// positions so they do not depend on how a context numbers the floor.
+class DeadlockPatternStore {
+public:
+    // Reads `filename`, keeping only layouts found in `levelFiles`, or
+    // every layout if the list is empty. False if the file cannot be opened.
+    bool load(const char* filename, const std::vector<std::string>& levelFiles);
+    bool save(const char* filename) const;
+    
+    // Adds the level's stored patterns to `out`, in the cells of `context`.
+    void fill(const Level& level, int playerX, int playerY, const SolverContext& context,
+              DeadlockPatterns& out) const;
+    
+    // Keeps every pattern of `learned` not stored yet. Returns how many.
+    int merge(const Level& level, int playerX, int playerY, const SolverContext& context,
+              const DeadlockPatterns& learned);
+    
+    size_t size() const;
+
+private:
+    struct StoredPattern {
+        std::vector<int> boxes;     // board indices, y * width + x
+        std::vector<int> area;
+        
+        bool operator==(const StoredPattern& other) const {
+            return boxes == other.boxes && area == other.area;
+        }
+    };
+    
+    std::unordered_map<uint64_t, std::vector<StoredPattern>> entries;
+};
+
+extern DeadlockPatternStore deadlockPatternStore;
+extern const char* DEADLOCK_PATTERN_FILE;
@@ -0,0 +1,685 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "box_matching.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
+
+// Breadth-first search over pushes that keeps its states on disk, for
+// levels whose state space does not fit in memory. Every layer of states
+// one push further from the start is a sorted file, and so is the set of
+// all states seen. Expanding a layer fills a bounded buffer with children,
+// which is sorted and written out as a run whenever it fills up; the runs
+// are then merged, and a second streaming merge against the seen set drops
+// the states met before. Files are only ever read and written front to
+// back. The first goal found is reached with the fewest pushes.
+//
+// States are stored with the player's region keyed by its lowest cell, as
+// in push-level A*. Records are prefix-compressed: each one keeps only the
+// bytes that differ from the one before it in sorted order.
+class ExternalSolver {
+public:
+    static const size_t DEFAULT_MEMORY_MB = 64;
+    static const int DEFAULT_TIME_LIMIT_MS = 600000;
+    
+    ExternalSolver()
+        : contextReady(false), workDir("."), memoryBudgetMb(DEFAULT_MEMORY_MB), timeLimitMs(DEFAULT_TIME_LIMIT_MS),
+          nodeLimit(0), control(nullptr), patterns(nullptr), keyBytes(0), fileCounter(0), nodesExplored(0), layers(0),
+          maxLayerSize(0), bytesWritten(0), diskBytes(0), peakDiskBytes(0), peakMemoryBytes(0), aborted(false), cancelled(false),
+          startTime(0), executionTimeMs(0) {}
+    
+    ~ExternalSolver() { removeFiles(); }
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    // Directory the layer files go to; it must exist. They are removed
+    // again when the solve ends.
+    void setWorkDir(const std::string& dir) { workDir = dir.empty() ? "." : dir; }
+    
+    // Memory for the child buffer; about as much again goes to the file
+    // buffers of a merge.
+    void setMemoryBudgetMb(size_t budget) { memoryBudgetMb = std::max<size_t>(1, budget); }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Stops after about `limit` expansions; 0 means no limit.
+    void setNodeLimit(long long limit) { nodeLimit = limit; }
+    
+    // Progress goes to `shared`, which may also cancel the search.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to prune pushes with, or null. Only read.
+    void setPatterns(const DeadlockPatterns* table) { patterns = table; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        startTime = solverClockMs();
+        nodesExplored = 0;
+        layers = 0;
+        maxLayerSize = 0;
+        bytesWritten = 0;
+        diskBytes = 0;
+        peakDiskBytes = 0;
+        peakMemoryBytes = 0;
+        aborted = false;
+        cancelled = false;
+        progress.attach(control);
+        
+        std::string solution = run(level, playerX, playerY);
+        
+        removeFiles();
+        progress.finish();
+        executionTimeMs = solverClockMs() - startTime;
+        contextReady = false;
+        return solution;
+    }
+    
+    long long getNodesExplored() const { return nodesExplored; }
+    int getLayers() const { return layers; }
+    long long getMaxLayerSize() const { return maxLayerSize; }
+    long long getBytesWritten() const { return bytesWritten; }
+    // Most disk space the layer, run and seen files took at once.
+    long long getPeakDiskBytes() const { return peakDiskBytes; }
+    bool wasAborted() const { return aborted; }
+    bool wasCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+    // Largest the child buffer grew; a merge only holds one record per file.
+    size_t getMemoryBytes() const { return peakMemoryBytes; }
+
+private:
+    // Box bits, then the player cell; only the first keyBytes are used.
+    static const int MAX_KEY_BYTES = MAX_FLOOR_CELLS / 8 + 2;
+    // Files merged at once; more runs than this are merged in rounds.
+    static const size_t MERGE_FAN_IN = 64;
+    // Keys a merge or subtraction reads between two checks of the time
+    // limit and the cancel flag; a power of two.
+    static const long long MERGE_POLL_KEYS = 1 << 16;
+    
+    struct StateKey {
+        uint8_t bytes[MAX_KEY_BYTES];
+        
+        bool operator<(const StateKey& other) const { return std::memcmp(bytes, other.bytes, MAX_KEY_BYTES) < 0; }
+        bool operator==(const StateKey& other) const { return std::memcmp(bytes, other.bytes, MAX_KEY_BYTES) == 0; }
+        bool operator!=(const StateKey& other) const { return !(*this == other); }
+    };
+    
+    // A sorted state file: one byte telling how many leading bytes a record
+    // shares with the one before it, then the rest of the record.
+    class KeyWriter {
+    public:
+        KeyWriter(const std::string& path, int keyBytes) : file(path, std::ios::binary), keyBytes(keyBytes), count(0), bytes(0) {}
+        
+        bool good() const { return file.good(); }
+        
+        void write(const StateKey& key) {
+            int shared = 0;
+            if (count > 0) {
+                while (shared < keyBytes && key.bytes[shared] == last.bytes[shared]) {
+                    shared++;
+                }
+            }
+            file.put((char)shared);
+            file.write((const char*)key.bytes + shared, keyBytes - shared);
+            bytes += 1 + keyBytes - shared;
+            last = key;
+            count++;
+        }
+        
+        long long getCount() const { return count; }
+        long long getBytes() const { return bytes; }
+    
+    private:
+        std::ofstream file;
+        int keyBytes;
+        StateKey last;
+        long long count;
+        long long bytes;
+    };
+    
+    class KeyReader {
+    public:
+        KeyReader(const std::string& path, int keyBytes) : file(path, std::ios::binary), keyBytes(keyBytes) {
+            std::memset(&current, 0, sizeof(current));
+        }
+        
+        bool next(StateKey& key) {
+            int shared = file.get();
+            if (shared == EOF || shared > keyBytes ||
+                !file.read((char*)current.bytes + shared, keyBytes - shared)) {
+                return false;
+            }
+            key = current;
+            return true;
+        }
+    
+    private:
+        std::ifstream file;
+        int keyBytes;
+        StateKey current;
+    };
+    
+    SolverContext context;
+    bool contextReady;
+    std::string workDir;
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    long long nodeLimit;
+    ProgressReporter progress;
+    SolverControl* control;
+    const DeadlockPatterns* patterns;
+    
+    int keyBytes;
+    std::string filePrefix;
+    int fileCounter;
+    std::vector<std::string> files;
+    std::vector<long long> fileBytes;
+    std::vector<char> region;
+    std::vector<char> childRegion;
+    std::vector<int> cellStack;
+    BoxMatching matching;
+    BoxMatching childMatching;
+    
+    long long nodesExplored;
+    int layers;
+    long long maxLayerSize;
+    long long bytesWritten;
+    long long diskBytes;
+    long long peakDiskBytes;
+    size_t peakMemoryBytes;
+    bool aborted;
+    bool cancelled;
+    long long startTime;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "External search: level has no usable floor or more than "
+                      << MAX_FLOOR_CELLS << " floor cells" << std::endl;
+            return "";
+        }
+        
+        PackedState start;
+        if (!context.packState(level, playerX, playerY, start)) {
+            std::cout << "External search: box or player outside the playable floor" << std::endl;
+            return "";
+        }
+        if (start.boxes.count() == 0 || context.targetCells.empty()) {
+            return "";
+        }
+        if (start.boxes.isSubsetOf(context.targets)) {
+            return "";
+        }
+        
+        keyBytes = (context.floorCount + 7) / 8 + 2;
+        // Unique across processes sharing the directory and across solvers
+        // in one process, even where random_device is not random.
+        std::random_device random;
+        filePrefix = workDir + "/sokoban_external_" + std::to_string(random() ^ (unsigned)solverClockMs()) + "_" +
+                     std::to_string((uintptr_t)this) + "_";
+        fileCounter = 0;
+        
+        PackedState root = start;
+        root.player = fillRegion(root.boxes, root.player, region);
+        std::vector<StateKey> keys(1, toKey(root));
+        std::vector<std::string> layerFiles(1, writeKeys(keys));
+        std::string seenFile = writeKeys(keys);
+        if (layerFiles[0].empty() || seenFile.empty()) {
+            return "";
+        }
+        layers = 1;
+        
+        PackedState goal;
+        while (true) {
+            std::vector<std::string> runs;
+            bool found = false;
+            if (!expandLayer(layerFiles.back(), runs, goal, found)) {
+                return "";
+            }
+            if (found) {
+                return rebuildPath(start, goal, layerFiles);
+            }
+            
+            std::string children = mergeFiles(runs);
+            if (children.empty()) {
+                return "";
+            }
+            long long layerSize = 0;
+            std::string layer = subtractSeen(children, seenFile, layerSize);
+            removeFile(children);
+            if (layer.empty()) {
+                return "";
+            }
+            if (layerSize == 0) {
+                std::cout << "External search: no more states after " << layerFiles.size() << " layers" << std::endl;
+                return "";
+            }
+            
+            std::string seen = mergeRound(std::vector<std::string>{seenFile, layer});
+            removeFile(seenFile);
+            if (seen.empty()) {
+                return "";
+            }
+            seenFile = seen;
+            layerFiles.push_back(layer);
+            layers = layerFiles.size();
+            maxLayerSize = std::max(maxLayerSize, layerSize);
+        }
+    }
+    
+    // Expands every state of a layer file into sorted runs of children. Sets
+    // `found` and `goal` when a child is solved. False if the search has to
+    // stop.
+    bool expandLayer(const std::string& layerFile, std::vector<std::string>& runs, PackedState& goal, bool& found) {
+        // Reserved once, so the buffer never doubles past the budget; pages
+        // it does not reach are never touched.
+        size_t bufferLimit = std::max<size_t>(1024, (memoryBudgetMb << 20) / sizeof(StateKey));
+        std::vector<StateKey> buffer;
+        buffer.reserve(bufferLimit);
+        
+        KeyReader reader(layerFile, keyBytes);
+        StateKey key;
+        PackedState state;
+        while (reader.next(key)) {
+            if (budgetExceeded()) {
+                return false;
+            }
+            nodesExplored++;
+            fromKey(key, state);
+            fillRegion(state.boxes, state.player, region);
+            matching.assign(context, state.boxes);
+            
+            for (int box = state.boxes.next(0); box >= 0; box = state.boxes.next(box + 1)) {
+                for (int dir = 0; dir < 4; dir++) {
+                    PackedState child;
+                    if (!makeChild(state, box, dir, child)) {
+                        continue;
+                    }
+                    if (child.boxes.isSubsetOf(context.targets)) {
+                        goal = child;
+                        found = true;
+                        return true;
+                    }
+                    
+                    buffer.push_back(toKey(child));
+                    if (buffer.size() >= bufferLimit) {
+                        peakMemoryBytes = std::max(peakMemoryBytes, buffer.size() * sizeof(StateKey));
+                        runs.push_back(writeKeys(buffer));
+                        if (runs.back().empty()) {
+                            return false;
+                        }
+                        buffer.clear();
+                    }
+                }
+            }
+        }
+        
+        peakMemoryBytes = std::max(peakMemoryBytes, buffer.size() * sizeof(StateKey));
+        runs.push_back(writeKeys(buffer));
+        return !runs.back().empty();
+    }
+    
+    // The push of the box on `box` towards `dir` from `state`, whose region
+    // is in `region`, unless it is illegal or leads to a known deadlock.
+    bool makeChild(const PackedState& state, int box, int dir, PackedState& child) {
+        int from = context.neighbour(box, (dir + 2) % 4);
+        int to = context.neighbour(box, dir);
+        if (from < 0 || !region[from] || to < 0 || state.boxes.test(to) || context.isDead(to)) {
+            return false;
+        }
+        
+        child.boxes = state.boxes;
+        child.boxes.reset(box);
+        child.boxes.set(to);
+        if (context.isFreezeDeadlock(child.boxes, to) || (patterns && patterns->matches(child.boxes, to, box))) {
+            return false;
+        }
+        childMatching = matching;
+        childMatching.moveBox(box, to);
+        if (childMatching.cost() >= BoxMatching::INFINITE_COST) {
+            return false;
+        }
+        
+        child.player = fillRegion(child.boxes, box, childRegion);
+        return true;
+    }
+    
+    // Every state one push before `state` whose push the player can make,
+    // found by pulling each box back. Sorted and without duplicates.
+    void collectParents(const PackedState& state, std::vector<StateKey>& parents) {
+        parents.clear();
+        fillRegion(state.boxes, state.player, region);
+        
+        for (int box = state.boxes.next(0); box >= 0; box = state.boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int from = context.neighbour(box, (dir + 2) % 4);
+                int pusher = from >= 0 ? context.neighbour(from, (dir + 2) % 4) : -1;
+                if (from < 0 || !region[from] || pusher < 0 || state.boxes.test(pusher)) {
+                    continue;
+                }
+                
+                PackedState parent;
+                parent.boxes = state.boxes;
+                parent.boxes.reset(box);
+                parent.boxes.set(from);
+                parent.player = fillRegion(parent.boxes, pusher, childRegion);
+                parents.push_back(toKey(parent));
+            }
+        }
+        
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+    }
+    
+    // Walks back from the goal one layer at a time: the parent is whichever
+    // pulled-back state the layer holds, found by one streaming pass over
+    // its file. Then replays the pushes from the real start position.
+    std::string rebuildPath(const PackedState& start, const PackedState& goal,
+                            const std::vector<std::string>& layerFiles) {
+        std::vector<PackedState> chain(1, goal);
+        std::vector<StateKey> parents;
+        for (size_t layer = layerFiles.size(); layer-- > 0;) {
+            collectParents(chain.back(), parents);
+            KeyReader reader(layerFiles[layer], keyBytes);
+            StateKey key;
+            size_t next = 0;
+            bool matched = false;
+            while (!matched && next < parents.size() && reader.next(key)) {
+                while (next < parents.size() && parents[next] < key) {
+                    next++;
+                }
+                matched = next < parents.size() && parents[next] == key;
+            }
+            if (!matched) {
+                std::cout << "External search: lost the path at layer " << layer << std::endl;
+                return "";
+            }
+            PackedState parent;
+            fromKey(key, parent);
+            chain.push_back(parent);
+        }
+        std::reverse(chain.begin(), chain.end());
+        
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        std::string result;
+        std::string walk;
+        for (size_t i = 1; i < chain.size(); i++) {
+            int from = -1, to = -1;
+            for (int cell = 0; cell < context.floorCount; cell++) {
+                if (boxes.test(cell) && !chain[i].boxes.test(cell)) from = cell;
+                if (!boxes.test(cell) && chain[i].boxes.test(cell)) to = cell;
+            }
+            int dir = 0;
+            while (dir < 4 && (from < 0 || context.neighbour(from, dir) != to)) {
+                dir++;
+            }
+            int pushFrom = dir < 4 ? context.neighbour(from, (dir + 2) % 4) : -1;
+            if (pushFrom < 0 || !context.findWalk(boxes, player, pushFrom, walk)) {
+                return "";
+            }
+            result += walk;
+            result += dirChars[dir];
+            
+            boxes.reset(from);
+            boxes.set(to);
+            player = from;
+        }
+        
+        return result;
+    }
+    
+    // The states of `children` that `seenFile` does not hold, as a new
+    // file; both inputs are sorted. Empty if the search has to stop.
+    std::string subtractSeen(const std::string& children, const std::string& seenFile, long long& count) {
+        std::string path = newFile();
+        bool ok;
+        long long bytes;
+        {
+            KeyWriter writer(path, keyBytes);
+            KeyReader childReader(children, keyBytes);
+            KeyReader seenReader(seenFile, keyBytes);
+            StateKey child, seen;
+            bool haveSeen = seenReader.next(seen);
+            long long read = 0;
+            while (childReader.next(child)) {
+                if (mergeAborted(++read)) {
+                    break;
+                }
+                while (haveSeen && seen < child) {
+                    haveSeen = seenReader.next(seen);
+                }
+                if (!haveSeen || child != seen) {
+                    writer.write(child);
+                }
+            }
+            ok = writer.good();
+            bytes = writer.getBytes();
+            count = writer.getCount();
+        }
+        if (aborted) {
+            removeFile(path);
+            return "";
+        }
+        if (!ok) {
+            return failedWrite(path);
+        }
+        closeFile(path, bytes);
+        return path;
+    }
+    
+    // Merges sorted files into one without duplicates, in rounds of at most
+    // MERGE_FAN_IN files, and removes them. Empty if the search has to
+    // stop; solve() removes whatever files are left.
+    std::string mergeFiles(std::vector<std::string> inputs) {
+        while (inputs.size() > 1) {
+            std::vector<std::string> outputs;
+            for (size_t first = 0; first < inputs.size(); first += MERGE_FAN_IN) {
+                std::vector<std::string> group(inputs.begin() + first,
+                                               inputs.begin() + std::min(inputs.size(), first + MERGE_FAN_IN));
+                std::string merged = mergeRound(group);
+                for (const std::string& input : group) {
+                    removeFile(input);
+                }
+                if (merged.empty()) {
+                    return "";
+                }
+                outputs.push_back(merged);
+            }
+            inputs.swap(outputs);
+        }
+        return inputs.empty() ? "" : inputs[0];
+    }
+    
+    std::string mergeRound(const std::vector<std::string>& inputs) {
+        typedef std::pair<StateKey, size_t> Head;
+        auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        
+        std::vector<std::unique_ptr<KeyReader>> readers;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            readers.emplace_back(new KeyReader(inputs[i], keyBytes));
+            StateKey key;
+            if (readers[i]->next(key)) {
+                heads.push(Head(key, i));
+            }
+        }
+        
+        std::string path = newFile();
+        bool ok;
+        long long bytes;
+        {
+            KeyWriter writer(path, keyBytes);
+            StateKey lastWritten;
+            long long read = 0;
+            while (!heads.empty()) {
+                if (mergeAborted(++read)) {
+                    break;
+                }
+                Head head = heads.top();
+                heads.pop();
+                if (writer.getCount() == 0 || head.first != lastWritten) {
+                    writer.write(head.first);
+                    lastWritten = head.first;
+                }
+                StateKey key;
+                if (readers[head.second]->next(key)) {
+                    heads.push(Head(key, head.second));
+                }
+            }
+            ok = writer.good();
+            bytes = writer.getBytes();
+        }
+        if (aborted) {
+            removeFile(path);
+            return "";
+        }
+        if (!ok) {
+            return failedWrite(path);
+        }
+        closeFile(path, bytes);
+        return path;
+    }
+    
+    // Sorts the keys, drops duplicates and writes them to a new file. Empty
+    // if it cannot be written.
+    std::string writeKeys(std::vector<StateKey>& keys) {
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        
+        std::string path = newFile();
+        KeyWriter writer(path, keyBytes);
+        for (const StateKey& key : keys) {
+            writer.write(key);
+        }
+        if (!writer.good()) {
+            return failedWrite(path);
+        }
+        closeFile(path, writer.getBytes());
+        return path;
+    }
+    
+    std::string newFile() {
+        std::string path = filePrefix + std::to_string(fileCounter++) + ".bin";
+        files.push_back(path);
+        fileBytes.push_back(0);
+        return path;
+    }
+    
+    // Counts a finished file towards the disk figures.
+    void closeFile(const std::string& path, long long bytes) {
+        auto it = std::find(files.begin(), files.end(), path);
+        fileBytes[it - files.begin()] = bytes;
+        bytesWritten += bytes;
+        diskBytes += bytes;
+        peakDiskBytes = std::max(peakDiskBytes, diskBytes);
+    }
+    
+    std::string failedWrite(const std::string& path) {
+        std::cout << "External search: cannot write " << path << std::endl;
+        aborted = true;
+        removeFile(path);
+        return "";
+    }
+    
+    void removeFile(const std::string& path) {
+        auto it = std::find(files.begin(), files.end(), path);
+        if (it == files.end()) {
+            return;
+        }
+        std::remove(path.c_str());
+        diskBytes -= fileBytes[it - files.begin()];
+        fileBytes.erase(fileBytes.begin() + (it - files.begin()));
+        files.erase(it);
+    }
+    
+    void removeFiles() {
+        while (!files.empty()) {
+            removeFile(files.back());
+        }
+    }
+    
+    bool budgetExceeded() {
+        if ((nodesExplored & 1023) != 0) {
+            return false;
+        }
+        return limitsReached();
+    }
+    
+    // The merge phases expand nothing, so they poll by keys read instead.
+    bool mergeAborted(long long read) {
+        if ((read & (MERGE_POLL_KEYS - 1)) != 0) {
+            return false;
+        }
+        return limitsReached();
+    }
+    
+    // Reports progress and sets `aborted` once the search is cancelled or
+    // out of time or nodes.
+    bool limitsReached() {
+        progress.report(nodesExplored, maxLayerSize, 0);
+        cancelled = progress.cancelled();
+        aborted = aborted || cancelled || (int)(solverClockMs() - startTime) >= timeLimitMs ||
+                  (nodeLimit > 0 && nodesExplored >= nodeLimit);
+        return aborted;
+    }
+    
+    StateKey toKey(const PackedState& state) const {
+        StateKey key;
+        std::memset(&key, 0, sizeof(key));
+        for (int i = 0; i < keyBytes - 2; i++) {
+            key.bytes[i] = (uint8_t)(state.boxes.words[i / 8] >> (i % 8 * 8));
+        }
+        key.bytes[keyBytes - 2] = (uint8_t)(state.player >> 8);
+        key.bytes[keyBytes - 1] = (uint8_t)state.player;
+        return key;
+    }
+    
+    void fromKey(const StateKey& key, PackedState& state) const {
+        state.boxes.clear();
+        for (int i = 0; i < keyBytes - 2; i++) {
+            state.boxes.words[i / 8] |= (uint64_t)key.bytes[i] << (i % 8 * 8);
+        }
+        state.player = key.bytes[keyBytes - 2] << 8 | key.bytes[keyBytes - 1];
+    }
+    
+    // Flood fills the player's region into `cells` and returns its lowest
+    // cell.
+    int fillRegion(const BoxSet& boxes, int player, std::vector<char>& cells) {
+        cells.assign(context.floorCount, 0);
+        cellStack.assign(1, player);
+        cells[player] = 1;
+        int normalized = player;
+        
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            normalized = std::min(normalized, cell);
+            
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context.neighbour(cell, dir);
+                if (next >= 0 && !cells[next] && !boxes.test(next)) {
+                    cells[next] = 1;
+                    cellStack.push_back(next);
+                }
+            }
+        }
+        
+        return normalized;
+    }
+};
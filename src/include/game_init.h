@@ -12,6 +12,9 @@ bool createWindowAndRenderer(SDL_Window** window, SDL_Renderer** renderer);
 void destroyWindowAndRenderer(SDL_Window* window, SDL_Renderer* renderer);
 
 void initGame();
+// Loads dynamicLevelFiles[currentLevelIndex] into game.activeLevel and
+// builds its solver tables; exits if the file cannot be loaded.
+void loadCurrentLevel();
 bool initGameResources(SDL_Renderer* renderer);
 void cleanupGameResources();
 bool initMenuBackground(SDL_Renderer* renderer);
@@ -148,6 +148,7 @@ extern GameData game;
 
 void initializeLevel(Level* level, PlayerInfo* player, int playerStartX, int playerStartY);
 bool loadLevelFromFile(const char* filename, Level* outLevel);
+void copyLevel(const Level& source, Level* outLevel);
 void recordMove(const MoveRecord& move);
 bool undoMove();
 bool loadHighScores(const char* filename);
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "box_matching.h"
+#include "transposition_table.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
+#include "advanced_solver.h"
+
+// Iterative deepening A* over pushes. There is a single mutable board that
+// pushes are made on and undone in place, so memory grows with the depth of
+// the search rather than with the number of states seen. A fixed-size
+// transposition table cuts off states already searched with at least as
+// much budget left in the current iteration; it is never resized.
+class IdaSolver {
+public:
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    static const size_t DEFAULT_TABLE_MB = 64;
+    
+    explicit IdaSolver(size_t tableMb = DEFAULT_TABLE_MB)
+        : contextReady(false), timeLimitMs(DEFAULT_TIME_LIMIT_MS), nodeLimit(0), player(0), boxHash(0),
+          boxHashCheck(0), control(nullptr), patterns(nullptr), aborted(false), cancelled(false), startTime(0), nodesExplored(0), iterations(0),
+          peakBytes(0), executionTimeMs(0) {
+        table.allocate(tableMb << 20);
+    }
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Stops after about `limit` nodes, whatever the machine's speed; 0 means
+    // no limit.
+    void setNodeLimit(int limit) { nodeLimit = limit; }
+    
+    // Progress goes to `shared`, which may also cancel the search.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to prune pushes with, or null. Only read.
+    void setPatterns(const DeadlockPatterns* table) { patterns = table; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        startTime = solverClockMs();
+        nodesExplored = 0;
+        iterations = 0;
+        peakBytes = 0;
+        aborted = false;
+        cancelled = false;
+        path.clear();
+        progress.attach(control);
+        
+        std::string solution = run(level, playerX, playerY);
+        
+        progress.finish();
+        executionTimeMs = solverClockMs() - startTime;
+        contextReady = false;
+        return solution;
+    }
+    
+    int getNodesExplored() const { return nodesExplored; }
+    int getIterations() const { return iterations; }
+    bool wasAborted() const { return aborted; }
+    bool wasCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+    // Most table memory one iteration used; the per-depth scratch is small
+    // beside it.
+    size_t getPeakBytes() const { return peakBytes; }
+
+private:
+    static const int FOUND = -1;
+    static const int NOT_FOUND = BoxMatching::INFINITE_COST;
+    
+    struct Child {
+        PushMove push;
+        int h;
+        
+        Child(const PushMove& push = PushMove(), int h = 0) : push(push), h(h) {}
+    };
+    
+    SolverContext context;
+    bool contextReady;
+    int timeLimitMs;
+    int nodeLimit;
+    
+    // Lowest g at which each state was entered in the current iteration.
+    TranspositionTable table;
+    
+    // The board being searched, with its Zobrist keys over the boxes.
+    BoxSet boxes;
+    int player;
+    uint64_t boxHash;
+    uint64_t boxHashCheck;
+    
+    // Per-depth scratch: the assignment of each node on the current path and
+    // the children it still has to try.
+    std::vector<BoxMatching> matchings;
+    std::vector<std::vector<Child>> children;
+    std::vector<PushMove> path;
+    std::vector<char> region;
+    std::vector<int> cellStack;
+    
+    ProgressReporter progress;
+    SolverControl* control;
+    const DeadlockPatterns* patterns;
+    bool aborted;
+    bool cancelled;
+    long long startTime;
+    int nodesExplored;
+    int iterations;
+    size_t peakBytes;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "IDA*: level has no usable floor or more than "
+                      << MAX_FLOOR_CELLS << " floor cells" << std::endl;
+            return "";
+        }
+        
+        PackedState start;
+        if (!context.packState(level, playerX, playerY, start)) {
+            std::cout << "IDA*: box or player outside the playable floor" << std::endl;
+            return "";
+        }
+        if (start.boxes.count() == 0 || context.targetCells.empty()) {
+            return "";
+        }
+        
+        boxes = start.boxes;
+        player = start.player;
+        boxHash = 0;
+        boxHashCheck = 0;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            boxHash ^= context.zobrist.boxKeys[box];
+            boxHashCheck ^= context.zobrist.boxCheckKeys[box];
+        }
+        
+        matchings.resize(1);
+        matchings[0].assign(context, boxes);
+        int bound = matchings[0].cost();
+        
+        while (bound < NOT_FOUND && !aborted) {
+            table.newAge();
+            iterations++;
+            int result = search(0, bound);
+            peakBytes = std::max(peakBytes, table.bytesUsed());
+            if (result == FOUND) {
+                return rebuildPath(start);
+            }
+            bound = result;
+        }
+        
+        if (cancelled) {
+            std::cout << "IDA*: cancelled at bound " << bound << std::endl;
+        } else if (aborted) {
+            std::cout << "IDA*: time or node limit reached at bound " << bound << std::endl;
+        }
+        return "";
+    }
+    
+    // Returns FOUND, or the lowest f above `bound` seen below this node.
+    int search(int g, int bound) {
+        nodesExplored++;
+        if ((nodesExplored & 1023) == 0) {
+            // The frontier of a depth-first search is the path it is on.
+            progress.report(nodesExplored, g, matchings[g].cost());
+            cancelled = progress.cancelled();
+            aborted = cancelled || (int)(solverClockMs() - startTime) >= timeLimitMs ||
+                      (nodeLimit > 0 && nodesExplored >= nodeLimit);
+        }
+        if (aborted) {
+            return NOT_FOUND;
+        }
+        
+        int f = g + matchings[g].cost();
+        if (f > bound) {
+            return f;
+        }
+        if (boxes.isSubsetOf(context.targets)) {
+            return FOUND;
+        }
+        
+        int normalized = fillRegion();
+        if (!enterTable(normalized, g)) {
+            return NOT_FOUND;
+        }
+        
+        if ((int)matchings.size() <= g + 1) {
+            matchings.resize(g + 2);
+            children.resize(g + 2);
+        }
+        collectChildren(g);
+        
+        int best = NOT_FOUND;
+        int savedPlayer = player;
+        // Deeper calls may grow `children`, so index it afresh each time.
+        for (size_t i = 0; i < children[g].size(); i++) {
+            Child child = children[g][i];
+            if (g + 1 + child.h > bound) {
+                best = std::min(best, g + 1 + child.h);
+                continue;
+            }
+            
+            int from = child.push.box;
+            int to = context.neighbour(from, child.push.dir);
+            makePush(from, to);
+            matchings[g + 1] = matchings[g];
+            matchings[g + 1].moveBox(from, to);
+            path.push_back(child.push);
+            
+            int result = search(g + 1, bound);
+            if (result == FOUND) {
+                return FOUND;
+            }
+            
+            path.pop_back();
+            makePush(to, from);
+            player = savedPlayer;
+            best = std::min(best, result);
+            if (aborted) {
+                break;
+            }
+        }
+        return best;
+    }
+    
+    // Moves a box and puts the player where the box was. Pushing it back
+    // the other way undoes the move, apart from the player.
+    void makePush(int from, int to) {
+        boxes.reset(from);
+        boxes.set(to);
+        boxHash ^= context.zobrist.boxKeys[from] ^ context.zobrist.boxKeys[to];
+        boxHashCheck ^= context.zobrist.boxCheckKeys[from] ^ context.zobrist.boxCheckKeys[to];
+        player = from;
+    }
+    
+    // Records that the state, with the player's region keyed by its lowest
+    // cell, was entered at depth g in this iteration. Returns false if it or
+    // a symmetric image of it was already entered at depth g or less.
+    bool enterTable(int normalized, int g) {
+        uint64_t key = boxHash ^ context.zobrist.playerKeys[normalized];
+        uint64_t check = boxHashCheck ^ context.zobrist.playerCheckKeys[normalized];
+        if (!context.symmetries.empty()) {
+            PackedState state;
+            state.boxes = boxes;
+            state.player = normalized;
+            context.canonicalKeys(state, &region, key, check);
+        }
+        bool collision;
+        return table.insert(key, check, g, collision);
+    }
+    
+    // Flood fills the player's region into `region` and returns its lowest
+    // cell.
+    int fillRegion() {
+        region.assign(context.floorCount, 0);
+        cellStack.assign(1, player);
+        region[player] = 1;
+        int normalized = player;
+        
+        while (!cellStack.empty()) {
+            int cell = cellStack.back();
+            cellStack.pop_back();
+            normalized = std::min(normalized, cell);
+            
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context.neighbour(cell, dir);
+                if (next >= 0 && !region[next] && !boxes.test(next)) {
+                    region[next] = 1;
+                    cellStack.push_back(next);
+                }
+            }
+        }
+        
+        return normalized;
+    }
+    
+    // Legal pushes from the current region that survive the dead square and
+    // freeze checks, cheapest heuristic first.
+    void collectChildren(int g) {
+        std::vector<Child>& list = children[g];
+        list.clear();
+        
+        BoxMatching& probe = matchings[g + 1];
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int from = context.neighbour(box, (dir + 2) % 4);
+                int to = context.neighbour(box, dir);
+                if (from < 0 || !region[from] || to < 0 || boxes.test(to) || context.isDead(to)) {
+                    continue;
+                }
+                
+                boxes.reset(box);
+                boxes.set(to);
+                bool frozen = context.isFreezeDeadlock(boxes, to) || (patterns && patterns->matches(boxes, to, box));
+                boxes.reset(to);
+                boxes.set(box);
+                if (frozen) {
+                    continue;
+                }
+                
+                probe = matchings[g];
+                probe.moveBox(box, to);
+                int h = probe.cost();
+                if (h < BoxMatching::INFINITE_COST) {
+                    list.push_back(Child(PushMove(box, dir), h));
+                }
+            }
+        }
+        
+        std::stable_sort(list.begin(), list.end(),
+                         [](const Child& a, const Child& b) { return a.h < b.h; });
+    }
+    
+    // Replays the pushes from the start position and fills in the walks.
+    std::string rebuildPath(const PackedState& start) {
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        BoxSet replay = start.boxes;
+        int walker = start.player;
+        std::string result;
+        std::string walk;
+        
+        for (const PushMove& push : path) {
+            int pushFrom = context.neighbour(push.box, (push.dir + 2) % 4);
+            if (pushFrom < 0 || !context.findWalk(replay, walker, pushFrom, walk)) {
+                return "";
+            }
+            result += walk;
+            result += dirChars[push.dir];
+            
+            replay.reset(push.box);
+            replay.set(context.neighbour(push.box, push.dir));
+            walker = push.box;
+        }
+        
+        return result;
+    }
+};
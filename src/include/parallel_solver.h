@@ -0,0 +1,585 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "solver_arena.h"
+#include "solver_queue.h"
+#include "box_matching.h"
+#include "transposition_table.h"
+#include "advanced_solver.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
+
+// Node references in the parallel search name the owning worker in the high
+// 32 bits and the index in its node table in the low 32 bits.
+inline int64_t makeNodeRef(int worker, int index) {
+    return (static_cast<int64_t>(worker) << 32) | static_cast<uint32_t>(index);
+}
+
+struct ParallelNode {
+    int64_t parent;
+    uint32_t move;
+    
+    ParallelNode(int64_t parent = -1, uint32_t move = 0) : parent(parent), move(move) {}
+};
+
+// A generated push state on its way to, or waiting in, its owner's open list.
+struct ParallelState {
+    PackedState packed;
+    int g;
+    int h;
+    int64_t parent;
+    uint32_t move;
+    uint64_t hash;
+    uint64_t hashCheck;
+    
+    ParallelState() : g(0), h(0), parent(-1), move(0), hash(0), hashCheck(0) {}
+    
+    int f() const { return g + h; }
+};
+
+// States are shipped between workers in batches. Any thread may push a batch;
+// only the owner takes them, and it always takes the whole list at once, so
+// a single atomic head pointer is enough and ABA cannot occur.
+struct StateBatch {
+    std::vector<ParallelState> states;
+    StateBatch* next;
+    
+    StateBatch() : next(nullptr) {}
+};
+
+class BatchInbox {
+public:
+    BatchInbox() : head(nullptr) {}
+    
+    ~BatchInbox() {
+        StateBatch* batch = takeAll();
+        while (batch) {
+            StateBatch* next = batch->next;
+            delete batch;
+            batch = next;
+        }
+    }
+    
+    void push(StateBatch* batch) {
+        batch->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(batch->next, batch)) {
+        }
+    }
+    
+    // Newest batch first.
+    StateBatch* takeAll() { return head.exchange(nullptr); }
+    
+    bool empty() const { return head.load() == nullptr; }
+
+private:
+    std::atomic<StateBatch*> head;
+};
+
+// Hash-distributed A* (HDA*) over pushes. Each state belongs to the worker
+// picked by the Zobrist key of its boxes; that worker alone keeps it in its
+// open and closed lists. Children owned by other workers are batched and
+// sent to them through lock-free inboxes.
+//
+// A worker that finds a goal publishes its cost as the incumbent, and states
+// with f at or above it are dropped. The search is over when every worker is
+// idle and no state is in flight. A worker only acknowledges the states it
+// received when it next goes idle, so a busy worker always keeps the
+// in-flight count above zero.
+//
+// Every worker gets an equal slice of the memory budget, a quarter of which
+// goes to its closed table as in A*. The search stops as soon as one worker
+// runs out of its slice, or when time runs out.
+class ParallelSolver {
+public:
+    static const int BATCH_SIZE = 64;
+    static const int FLUSH_INTERVAL = 32;
+    static const size_t DEFAULT_MEMORY_MB = 512;
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    static const size_t CLOSED_TABLE_SHARE = 4;
+    static const size_t CLOSED_BLOOM_SHARE = 64;
+    
+    explicit ParallelSolver(int threadCount = 0)
+        : contextReady(false), threadCount(threadCount), memoryBudgetMb(DEFAULT_MEMORY_MB),
+          timeLimitMs(DEFAULT_TIME_LIMIT_MS), nodeLimit(0), workerBudget(0), startTime(0), nodesExplored(0),
+          maxQueueSize(0), statesSent(0), limitReached(false), timedOut(false), memoryExceeded(false),
+          cancelled(false), control(nullptr), patterns(nullptr), peakBytes(0), executionTimeMs(0) {}
+    
+    // Worker threads for the next solve; zero means one per core.
+    void setThreadCount(int count) { threadCount = count; }
+    
+    // Shared evenly by the workers.
+    void setMemoryBudgetMb(size_t budget) { memoryBudgetMb = std::max<size_t>(1, budget); }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Stops after about `limit` expansions over all workers; 0 means no
+    // limit.
+    void setNodeLimit(int limit) { nodeLimit = limit; }
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    // Every worker adds its progress to `shared`, which may also cancel
+    // the search.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to prune pushes with, or null. Only read.
+    void setPatterns(const DeadlockPatterns* table) { patterns = table; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        startTime = solverClockMs();
+        nodesExplored = 0;
+        maxQueueSize = 0;
+        statesSent = 0;
+        limitReached = false;
+        timedOut = false;
+        memoryExceeded = false;
+        cancelled = false;
+        
+        std::string solution = run(level, playerX, playerY);
+        
+        peakBytes = 0;
+        for (const auto& worker : workers) {
+            peakBytes += worker->arena.bytesUsed() + worker->closed.bytesUsed();
+        }
+        workers.clear();
+        contextReady = false;
+        executionTimeMs = solverClockMs() - startTime;
+        return solution;
+    }
+    
+    int getThreadCount() const { return threadCount; }
+    int getNodesExplored() const { return nodesExplored; }
+    int getMaxQueueSize() const { return maxQueueSize; }
+    long long getStatesSent() const { return statesSent; }
+    // No solution, and a worker ran out of its slice of memory.
+    bool isLimitReached() const { return limitReached; }
+    bool isTimedOut() const { return timedOut; }
+    bool isCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+    // What every worker's arena and closed table held when the last solve
+    // ended.
+    size_t getPeakBytes() const { return peakBytes; }
+
+private:
+    struct Worker {
+        SolverArena arena;
+        ArenaTable<ParallelNode> nodes;
+        ArenaTable<ParallelState> openStates;
+        std::vector<int> freeSlots;
+        BucketQueue open;
+        TranspositionTable closed;
+        BatchInbox inbox;
+        std::vector<StateBatch*> outgoing;
+        BoxMatching matching;
+        BoxMatching childMatching;
+        std::vector<char> reachable;
+        std::vector<int> cellStack;
+        std::vector<PushMove> pushes;
+        ProgressReporter progress;
+        long long received;
+        long long sent;
+        int expanded;
+        int maxOpen;
+        bool idle;
+        
+        Worker() : nodes(arena), openStates(arena), received(0), sent(0), expanded(0), maxOpen(0), idle(true) {}
+        
+        ~Worker() {
+            for (StateBatch* batch : outgoing) {
+                delete batch;
+            }
+        }
+    };
+    
+    SolverContext context;
+    bool contextReady;
+    int threadCount;
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    int nodeLimit;
+    size_t workerBudget;
+    long long startTime;
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> idleWorkers;
+    std::atomic<long long> inFlight;
+    std::atomic<int> expandedTotal;
+    std::atomic<int> incumbent;
+    std::atomic<bool> stop;
+    std::mutex goalMutex;
+    int64_t goalRef;
+    
+    int nodesExplored;
+    int maxQueueSize;
+    long long statesSent;
+    bool limitReached;
+    std::atomic<bool> timedOut;
+    std::atomic<bool> memoryExceeded;
+    std::atomic<bool> cancelled;
+    SolverControl* control;
+    const DeadlockPatterns* patterns;
+    size_t peakBytes;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "Parallel solver: level has no usable floor or more than "
+                      << MAX_FLOOR_CELLS << " floor cells" << std::endl;
+            return "";
+        }
+        
+        ParallelState root;
+        if (!context.packState(level, playerX, playerY, root.packed)) {
+            std::cout << "Parallel solver: box or player outside the playable floor" << std::endl;
+            return "";
+        }
+        if (root.packed.boxes.count() == 0 || context.targetCells.empty()) {
+            return "";
+        }
+        
+        BoxMatching rootMatching;
+        rootMatching.assign(context, root.packed.boxes);
+        root.h = rootMatching.cost();
+        if (root.h >= BoxMatching::INFINITE_COST) {
+            return "";
+        }
+        root.hash = context.zobrist.playerKeys[root.packed.player];
+        root.hashCheck = context.zobrist.playerCheckKeys[root.packed.player];
+        const BoxSet& boxes = root.packed.boxes;
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            root.hash ^= context.zobrist.boxKeys[box];
+            root.hashCheck ^= context.zobrist.boxCheckKeys[box];
+        }
+        
+        int count = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+        count = std::max(1, count);
+        threadCount = count;
+        
+        workerBudget = (memoryBudgetMb << 20) / count;
+        workers.clear();
+        for (int i = 0; i < count; i++) {
+            workers.emplace_back(new Worker());
+            workers.back()->outgoing.assign(count, nullptr);
+            workers.back()->closed.allocate(workerBudget / CLOSED_TABLE_SHARE, workerBudget / CLOSED_BLOOM_SHARE);
+        }
+        
+        idleWorkers = count;
+        inFlight = 1;
+        expandedTotal = 0;
+        incumbent = BoxMatching::INFINITE_COST;
+        stop = false;
+        goalRef = -1;
+        
+        StateBatch* first = new StateBatch();
+        first->states.push_back(root);
+        workers[ownerOf(root)]->inbox.push(first);
+        
+        std::vector<std::thread> threads;
+        for (int i = 0; i < count; i++) {
+            threads.emplace_back(&ParallelSolver::work, this, i);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            nodesExplored += worker->expanded;
+            maxQueueSize += worker->maxOpen;
+            statesSent += worker->sent;
+        }
+        limitReached = goalRef < 0 && !cancelled && memoryExceeded;
+        
+        if (goalRef < 0) {
+            return "";
+        }
+        return rebuildPath(root.packed, goalRef);
+    }
+    
+    // States with the same boxes go to the same worker whatever the player
+    // position, so a state is always compared against its own duplicates.
+    int ownerOf(const ParallelState& state) const {
+        uint64_t boxKey = state.hash ^ context.zobrist.playerKeys[state.packed.player];
+        boxKey ^= boxKey >> 29;
+        boxKey *= 0xbf58476d1ce4e5b9ULL;
+        boxKey ^= boxKey >> 32;
+        return static_cast<int>(boxKey % workers.size());
+    }
+    
+    void work(int self) {
+        Worker& worker = *workers[self];
+        worker.progress.attach(control);
+        int sinceFlush = 0;
+        
+        while (!stop) {
+            receive(worker);
+            
+            int slot = worker.open.pop();
+            if (slot < 0) {
+                flushAll(self);
+                sinceFlush = 0;
+                goIdle(worker);
+                continue;
+            }
+            
+            ParallelState current = worker.openStates[slot];
+            worker.freeSlots.push_back(slot);
+            if (current.f() >= incumbent) {
+                continue;
+            }
+            
+            expand(self, current);
+            if (++sinceFlush >= FLUSH_INTERVAL) {
+                flushAll(self);
+                sinceFlush = 0;
+            }
+        }
+        worker.progress.finish();
+    }
+    
+    void receive(Worker& worker) {
+        if (worker.inbox.empty()) {
+            return;
+        }
+        if (worker.idle) {
+            worker.idle = false;
+            idleWorkers--;
+        }
+        
+        StateBatch* batch = worker.inbox.takeAll();
+        while (batch) {
+            for (const ParallelState& state : batch->states) {
+                pushOpen(worker, state);
+            }
+            worker.received += batch->states.size();
+            StateBatch* next = batch->next;
+            delete batch;
+            batch = next;
+        }
+    }
+    
+    // Acknowledges everything received since the last idle spell, then
+    // checks whether the whole search has gone quiet.
+    void goIdle(Worker& worker) {
+        if (!worker.idle) {
+            inFlight -= worker.received;
+            worker.received = 0;
+            worker.idle = true;
+            idleWorkers++;
+        }
+        if (idleWorkers == (int)workers.size() && inFlight == 0) {
+            stop = true;
+        }
+        std::this_thread::yield();
+    }
+    
+    void pushOpen(Worker& worker, const ParallelState& state) {
+        int slot;
+        if (worker.freeSlots.empty()) {
+            slot = worker.openStates.push(state);
+        } else {
+            slot = worker.freeSlots.back();
+            worker.freeSlots.pop_back();
+            worker.openStates[slot] = state;
+        }
+        worker.open.push(slot, state.f(), state.h);
+        worker.maxOpen = std::max(worker.maxOpen, (int)worker.open.size());
+    }
+    
+    void send(int self, const ParallelState& state) {
+        int owner = ownerOf(state);
+        Worker& worker = *workers[self];
+        if (owner == self) {
+            pushOpen(worker, state);
+            return;
+        }
+        
+        StateBatch*& batch = worker.outgoing[owner];
+        if (!batch) {
+            batch = new StateBatch();
+        }
+        batch->states.push_back(state);
+        if ((int)batch->states.size() >= BATCH_SIZE) {
+            flush(self, owner);
+        }
+    }
+    
+    void flush(int self, int owner) {
+        StateBatch*& batch = workers[self]->outgoing[owner];
+        if (!batch) {
+            return;
+        }
+        inFlight += batch->states.size();
+        workers[self]->sent += batch->states.size();
+        workers[owner]->inbox.push(batch);
+        batch = nullptr;
+    }
+    
+    void flushAll(int self) {
+        for (int owner = 0; owner < (int)workers.size(); owner++) {
+            flush(self, owner);
+        }
+    }
+    
+    // Player region of the state, keyed by its lowest cell as in A*.
+    int computeReachable(Worker& worker, const BoxSet& boxes, int start) {
+        std::vector<char>& region = worker.reachable;
+        region.assign(context.floorCount, 0);
+        worker.cellStack.assign(1, start);
+        region[start] = 1;
+        int normalized = start;
+        
+        while (!worker.cellStack.empty()) {
+            int cell = worker.cellStack.back();
+            worker.cellStack.pop_back();
+            normalized = std::min(normalized, cell);
+            
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context.neighbour(cell, dir);
+                if (next >= 0 && !region[next] && !boxes.test(next)) {
+                    region[next] = 1;
+                    worker.cellStack.push_back(next);
+                }
+            }
+        }
+        
+        return normalized;
+    }
+    
+    void expand(int self, ParallelState& current) {
+        Worker& worker = *workers[self];
+        const BoxSet& boxes = current.packed.boxes;
+        int normalized = computeReachable(worker, boxes, current.packed.player);
+        const ZobristTable& zobrist = context.zobrist;
+        current.hash ^= zobrist.playerKeys[current.packed.player] ^ zobrist.playerKeys[normalized];
+        current.hashCheck ^= zobrist.playerCheckKeys[current.packed.player] ^ zobrist.playerCheckKeys[normalized];
+        current.packed.player = normalized;
+        
+        bool collision;
+        if (!worker.closed.insert(current.hash, current.hashCheck, current.g, collision)) {
+            return;
+        }
+        if (worker.arena.bytesReserved() + worker.closed.bytes() > workerBudget) {
+            memoryExceeded = true;
+            stop = true;
+            return;
+        }
+        
+        worker.expanded++;
+        if (worker.expanded % 256 == 0) {
+            worker.progress.report(worker.expanded, worker.open.size(), current.h);
+            if (worker.progress.cancelled()) {
+                cancelled = true;
+                stop = true;
+            }
+            int total = expandedTotal += 256;
+            if ((int)(solverClockMs() - startTime) >= timeLimitMs || (nodeLimit > 0 && total >= nodeLimit)) {
+                timedOut = true;
+                stop = true;
+            }
+        }
+        
+        int index = worker.nodes.push(ParallelNode(current.parent, current.move));
+        int64_t ref = makeNodeRef(self, index);
+        
+        if (boxes.isSubsetOf(context.targets)) {
+            std::lock_guard<std::mutex> lock(goalMutex);
+            if (current.g < incumbent) {
+                incumbent = current.g;
+                goalRef = ref;
+            }
+            return;
+        }
+        
+        worker.pushes.clear();
+        for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+            for (int dir = 0; dir < 4; dir++) {
+                int from = context.neighbour(box, (dir + 2) % 4);
+                int to = context.neighbour(box, dir);
+                if (from >= 0 && worker.reachable[from] && to >= 0 && !boxes.test(to) && !context.isDead(to)) {
+                    worker.pushes.push_back(PushMove(box, dir));
+                }
+            }
+        }
+        
+        worker.matching.assign(context, boxes);
+        for (const PushMove& push : worker.pushes) {
+            int box = push.box;
+            int to = context.neighbour(box, push.dir);
+            
+            ParallelState next = current;
+            next.packed.boxes.reset(box);
+            next.packed.boxes.set(to);
+            if (context.isFreezeDeadlock(next.packed.boxes, to) ||
+                (patterns && patterns->matches(next.packed.boxes, to, box))) {
+                continue;
+            }
+            
+            worker.childMatching = worker.matching;
+            worker.childMatching.moveBox(box, to);
+            next.h = worker.childMatching.cost();
+            next.g = current.g + 1;
+            if (next.h >= BoxMatching::INFINITE_COST || next.f() >= incumbent) {
+                continue;
+            }
+            
+            next.packed.player = box;
+            next.parent = ref;
+            next.move = encodePushMove(push);
+            next.hash ^= zobrist.playerKeys[normalized] ^ zobrist.playerKeys[box];
+            next.hashCheck ^= zobrist.playerCheckKeys[normalized] ^ zobrist.playerCheckKeys[box];
+            next.hash ^= zobrist.boxKeys[box] ^ zobrist.boxKeys[to];
+            next.hashCheck ^= zobrist.boxCheckKeys[box] ^ zobrist.boxCheckKeys[to];
+            send(self, next);
+        }
+    }
+    
+    // Walks parent references across the workers' node tables, then replays
+    // the pushes from the start position and fills in the walks.
+    std::string rebuildPath(const PackedState& start, int64_t goal) {
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        std::vector<uint32_t> moves;
+        for (int64_t ref = goal; ref >= 0; ) {
+            const ParallelNode& node = workers[ref >> 32]->nodes[ref & 0xFFFFFFFF];
+            if (node.parent < 0) {
+                break;
+            }
+            moves.push_back(node.move);
+            ref = node.parent;
+        }
+        std::reverse(moves.begin(), moves.end());
+        
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        std::string path;
+        std::string walk;
+        for (uint32_t move : moves) {
+            PushMove push = decodePushMove(move);
+            int pushFrom = context.neighbour(push.box, (push.dir + 2) % 4);
+            if (pushFrom < 0 || !context.findWalk(boxes, player, pushFrom, walk)) {
+                return "";
+            }
+            path += walk;
+            path += dirChars[push.dir];
+            
+            boxes.reset(push.box);
+            boxes.set(context.neighbour(push.box, push.dir));
+            player = push.box;
+        }
+        
+        return path;
+    }
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
+#include "advanced_solver.h"
+#include "ida_solver.h"
+#include "bidirectional_solver.h"
+
+// Searches a portfolio can race against each other.
+enum PortfolioStrategy {
+    PORTFOLIO_ASTAR,            // push-optimal A*; learns deadlock patterns
+    PORTFOLIO_ASTAR_MACROS,     // A* taking tunnels and goal rooms in one move
+    PORTFOLIO_IDA,              // push-optimal, memory bounded by its table
+    PORTFOLIO_BIDIRECTIONAL     // meets in the middle; not push-optimal
+};
+
+// Races differently configured searches on the same level, one thread
+// each, since no single one wins on every level. Each racer has its own
+// SolverControl; the first to find a solution has the others cancelled,
+// and they stop within a few hundred nodes. With improvement on, a winner
+// that is not push-optimal only cancels the other such racers: the
+// push-optimal ones run on until they finish or the time is up, and the
+// solution with the fewest pushes is returned.
+//
+// Every racer prunes with its own copy of the deadlock patterns, so none
+// reads a table another is writing. What the A* racers learn is added to
+// the caller's table once they have all stopped.
+class PortfolioSolver {
+public:
+    static const size_t DEFAULT_MEMORY_MB = 512;
+    static const int DEFAULT_TIME_LIMIT_MS = 10000;
+    static const int STRATEGY_COUNT = 4;
+    // How often the racers are checked on while they run.
+    static const int POLL_INTERVAL_MS = 5;
+    
+    PortfolioSolver()
+        : contextReady(false), memoryBudgetMb(DEFAULT_MEMORY_MB), timeLimitMs(DEFAULT_TIME_LIMIT_MS), improve(false),
+          control(nullptr), patterns(nullptr), nodesExplored(0), maxQueueSize(0), peakBytes(0), winner(nullptr),
+          winnerPushOptimal(false), firstSolutionMs(-1), firstPushes(0), pushes(0), patternsLearned(0),
+          limitReached(false), timedOut(false), cancelled(false), executionTimeMs(0) {
+        for (int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+            strategies.push_back((PortfolioStrategy)strategy);
+        }
+    }
+    
+    // Uses prebuilt level tables for the next solve instead of building them.
+    void setContext(const SolverContext& prepared) {
+        context = prepared;
+        contextReady = true;
+    }
+    
+    // Racers to start, in order; by default every strategy once.
+    void setStrategies(const std::vector<PortfolioStrategy>& list) { strategies = list; }
+    
+    // Shared by the racers: each A* gets a third, IDA* an eighth for its
+    // table and the bidirectional search a fifth.
+    void setMemoryBudgetMb(size_t budget) { memoryBudgetMb = std::max<size_t>(1, budget); }
+    
+    void setTimeLimitMs(int limit) { timeLimitMs = limit; }
+    
+    // Lets the push-optimal racers run on after a first solution.
+    void setImprove(bool enabled) { improve = enabled; }
+    
+    // Progress of all racers goes to `shared`, which may also cancel them.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    // Deadlock patterns to start from; the patterns the A* racers prove are
+    // added to them. Null turns both off.
+    void setPatterns(DeadlockPatterns* table) { patterns = table; }
+    
+    std::string solve(const Level& level, int playerX, int playerY) {
+        long long startTime = solverClockMs();
+        nodesExplored = 0;
+        maxQueueSize = 0;
+        peakBytes = 0;
+        winner = nullptr;
+        winnerPushOptimal = false;
+        firstSolutionMs = -1;
+        firstPushes = 0;
+        pushes = 0;
+        patternsLearned = 0;
+        limitReached = false;
+        timedOut = false;
+        cancelled = false;
+        progress.attach(control);
+        
+        std::string solution = run(level, playerX, playerY, startTime);
+        
+        progress.finish();
+        racers.clear();
+        contextReady = false;
+        executionTimeMs = solverClockMs() - startTime;
+        return solution;
+    }
+    
+    static const char* strategyName(PortfolioStrategy strategy) {
+        switch (strategy) {
+            case PORTFOLIO_ASTAR: return "astar";
+            case PORTFOLIO_ASTAR_MACROS: return "astar-macros";
+            case PORTFOLIO_IDA: return "ida";
+            case PORTFOLIO_BIDIRECTIONAL: return "bidirectional";
+        }
+        return "";
+    }
+    
+    static bool isPushOptimal(PortfolioStrategy strategy) {
+        return strategy == PORTFOLIO_ASTAR || strategy == PORTFOLIO_IDA;
+    }
+    
+    int getRacerCount() const { return strategies.size(); }
+    // Totals over every racer.
+    long long getNodesExplored() const { return nodesExplored; }
+    int getMaxQueueSize() const { return maxQueueSize; }
+    size_t getPeakBytes() const { return peakBytes; }
+    // Racer whose solution was returned, or null.
+    const char* getWinner() const { return winner; }
+    bool isWinnerPushOptimal() const { return winnerPushOptimal; }
+    // When the first solution came in, or -1 if none did, and its pushes.
+    long long getFirstSolutionMs() const { return firstSolutionMs; }
+    int getFirstPushes() const { return firstPushes; }
+    int getPushes() const { return pushes; }
+    int getPatternsLearned() const { return patternsLearned; }
+    // No solution, and some racer ran out of memory or nodes.
+    bool isLimitReached() const { return limitReached; }
+    bool isTimedOut() const { return timedOut; }
+    bool isCancelled() const { return cancelled; }
+    long long getExecutionTimeMs() const { return executionTimeMs; }
+
+private:
+    struct Racer {
+        PortfolioStrategy strategy;
+        SolverControl control;
+        DeadlockPatterns patterns;
+        std::thread thread;
+        std::atomic<bool> done;
+        bool collected;
+        std::string solution;
+        long long nodes;
+        int maxQueueSize;
+        size_t peakBytes;
+        bool limitReached;
+        
+        explicit Racer(PortfolioStrategy strategy)
+            : strategy(strategy), done(false), collected(false), nodes(0), maxQueueSize(0), peakBytes(0),
+              limitReached(false) {}
+    };
+    
+    SolverContext context;
+    bool contextReady;
+    std::vector<PortfolioStrategy> strategies;
+    size_t memoryBudgetMb;
+    int timeLimitMs;
+    bool improve;
+    SolverControl* control;
+    DeadlockPatterns* patterns;
+    ProgressReporter progress;
+    std::vector<std::unique_ptr<Racer>> racers;
+    
+    long long nodesExplored;
+    int maxQueueSize;
+    size_t peakBytes;
+    const char* winner;
+    bool winnerPushOptimal;
+    long long firstSolutionMs;
+    int firstPushes;
+    int pushes;
+    int patternsLearned;
+    bool limitReached;
+    bool timedOut;
+    bool cancelled;
+    long long executionTimeMs;
+    
+    std::string run(const Level& level, int playerX, int playerY, long long startTime) {
+        if (!contextReady && !context.build(level, playerX, playerY)) {
+            std::cout << "Portfolio: level has no usable floor or more than " << MAX_FLOOR_CELLS << " floor cells"
+                      << std::endl;
+            return "";
+        }
+        
+        racers.clear();
+        for (PortfolioStrategy strategy : strategies) {
+            racers.emplace_back(new Racer(strategy));
+            if (patterns) {
+                racers.back()->patterns = *patterns;
+            }
+        }
+        for (auto& racer : racers) {
+            racer->thread = std::thread(&PortfolioSolver::race, this, racer.get(), std::cref(level), playerX, playerY);
+        }
+        
+        std::string best;
+        size_t running = racers.size();
+        while (running > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+            reportProgress();
+            if (!cancelled && progress.cancelled()) {
+                cancelled = true;
+                stopRacers(false);
+            } else if (!timedOut && solverClockMs() - startTime >= timeLimitMs) {
+                timedOut = true;
+                stopRacers(false);
+            }
+            
+            for (auto& racer : racers) {
+                if (racer->collected || !racer->done.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                racer->thread.join();
+                racer->collected = true;
+                running--;
+                
+                int racerPushes;
+                if (racer->solution.empty() ||
+                    !replaySolution(level, playerX, playerY, racer->solution, racerPushes)) {
+                    continue;
+                }
+                if (firstSolutionMs < 0) {
+                    firstSolutionMs = solverClockMs() - startTime;
+                    firstPushes = racerPushes;
+                }
+                if (best.empty() || racerPushes < pushes ||
+                    (racerPushes == pushes && racer->solution.size() < best.size())) {
+                    best = racer->solution;
+                    pushes = racerPushes;
+                    winner = strategyName(racer->strategy);
+                    winnerPushOptimal = isPushOptimal(racer->strategy);
+                }
+                // A push-optimal solution cannot be beaten on pushes.
+                stopRacers(improve && !isPushOptimal(racer->strategy));
+            }
+        }
+        
+        for (auto& racer : racers) {
+            nodesExplored += racer->nodes;
+            maxQueueSize = std::max(maxQueueSize, racer->maxQueueSize);
+            peakBytes += racer->peakBytes;
+            limitReached = limitReached || racer->limitReached;
+            if (patterns && (racer->strategy == PORTFOLIO_ASTAR || racer->strategy == PORTFOLIO_ASTAR_MACROS)) {
+                for (const DeadlockPattern& pattern : racer->patterns.all()) {
+                    patternsLearned += patterns->add(pattern);
+                }
+            }
+        }
+        limitReached = limitReached && best.empty();
+        return best;
+    }
+    
+    // Runs on the racer's own thread.
+    void race(Racer* racer, const Level& level, int playerX, int playerY) {
+        DeadlockPatterns* table = patterns ? &racer->patterns : nullptr;
+        
+        switch (racer->strategy) {
+            case PORTFOLIO_ASTAR:
+            case PORTFOLIO_ASTAR_MACROS: {
+                AdvancedSolver solver;
+                solver.setContext(context);
+                solver.setControl(&racer->control);
+                solver.setPatterns(table);
+                solver.setMacroMoves(racer->strategy == PORTFOLIO_ASTAR_MACROS);
+                solver.setTimeLimitMs(timeLimitMs);
+                solver.setMemoryBudgetMb(std::max<size_t>(1, memoryBudgetMb / 3));
+                racer->solution = solver.solve(level, playerX, playerY);
+                racer->nodes = solver.getNodesExplored();
+                racer->maxQueueSize = solver.getMaxQueueSize();
+                racer->peakBytes = solver.getPeakBytes();
+                racer->limitReached = solver.isLimitReached();
+                break;
+            }
+            case PORTFOLIO_IDA: {
+                IdaSolver solver(std::max<size_t>(1, memoryBudgetMb / 8));
+                solver.setContext(context);
+                solver.setControl(&racer->control);
+                solver.setPatterns(table);
+                solver.setTimeLimitMs(timeLimitMs);
+                racer->solution = solver.solve(level, playerX, playerY);
+                racer->nodes = solver.getNodesExplored();
+                racer->peakBytes = solver.getPeakBytes();
+                break;
+            }
+            case PORTFOLIO_BIDIRECTIONAL: {
+                BidirectionalSolver solver;
+                solver.setContext(context);
+                solver.setControl(&racer->control);
+                solver.setPatterns(table);
+                solver.setTimeLimitMs(timeLimitMs);
+                solver.setMemoryBudgetMb(std::max<size_t>(1, memoryBudgetMb / 5));
+                racer->solution = solver.solve(level, playerX, playerY);
+                racer->nodes = solver.getNodesExplored();
+                racer->maxQueueSize = solver.getMaxQueueSize();
+                racer->peakBytes = solver.getPeakBytes();
+                racer->limitReached = solver.isLimitReached();
+                break;
+            }
+        }
+        
+        racer->done.store(true, std::memory_order_release);
+    }
+    
+    // Cancels the racers still running, or with `keepOptimal` only those
+    // that are not push-optimal.
+    void stopRacers(bool keepOptimal) {
+        for (auto& racer : racers) {
+            if (!keepOptimal || !isPushOptimal(racer->strategy)) {
+                racer->control.cancel = true;
+            }
+        }
+    }
+    
+    // Passes the racers' summed progress on, with the lowest heuristic any
+    // of them has reached.
+    void reportProgress() {
+        long long nodes = 0;
+        long long frontier = 0;
+        int bestH = INT_MAX;
+        for (const auto& racer : racers) {
+            nodes += racer->control.nodes.load(std::memory_order_relaxed);
+            frontier += racer->control.frontier.load(std::memory_order_relaxed);
+            bestH = std::min(bestH, racer->control.bestH.load(std::memory_order_relaxed));
+        }
+        progress.report(nodes, frontier, bestH);
+    }
+};
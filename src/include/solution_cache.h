@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "game_structures.h"
+
+// Solutions found earlier, kept on disk between runs. Entries are keyed by
+// a hash of the playable layout (the floor and targets the player can
+// reach, so padding around the walls does not matter) and a hash of the
+// boxes and player. A file in levels/ that changes gets a new layout hash,
+// and load() drops every layout no current level file has.
+class SolutionCache {
+public:
+    // Reads `filename`, keeping only layouts found in `levelFiles`.
+    // False if the file cannot be opened.
+    bool load(const char* filename, const std::vector<std::string>& levelFiles);
+    bool save(const char* filename) const;
+    
+    // Moves that solve the board from (playerX, playerY). Each hit is
+    // replayed before it is returned, so a hash collision or a damaged
+    // file can only cost a miss.
+    bool lookup(const Level& level, int playerX, int playerY, std::vector<char>& solution) const;
+    
+    void store(const Level& level, int playerX, int playerY, const std::vector<char>& solution);
+    
+    size_t size() const;
+
+private:
+    std::unordered_map<uint64_t, std::unordered_map<uint64_t, std::string>> entries;
+};
+
+// Hashes of the playable layout and of the box and player positions on it.
+// Both ignore tiles the player can never reach.
+uint64_t levelLayoutHash(const Level& level, int playerX, int playerY);
+uint64_t levelPositionHash(const Level& level, int playerX, int playerY);
+
+extern SolutionCache solutionCache;
+extern const char* SOLUTION_CACHE_FILE;
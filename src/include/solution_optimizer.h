@@ -0,0 +1,370 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include "game_structures.h"
+#include "solver_context.h"
+#include "box_matching.h"
+#include "solver_control.h"
+#include "advanced_solver.h"
+
+// What a SolutionOptimizer makes smaller.
+enum OptimizerObjective {
+    OPTIMIZE_MOVES,     // fewest moves, then fewest pushes
+    OPTIMIZE_PUSHES     // never more pushes; fewest moves among those
+};
+
+// Shortens a valid LURD solution after the fact. The solution is cut into
+// pushes, and windows of a few pushes are slid along it. Each window is
+// searched again for the fewest moves, then pushes, that lead from the
+// position at its start to the boxes at its end, with the walk to the push
+// that follows counted too. A shorter window replaces the old one. At the
+// end the walks between pushes are rebuilt as shortest walks.
+//
+// OPTIMIZE_MOVES may trade pushes for moves. For solutions from a
+// push-optimal search, OPTIMIZE_PUSHES keeps every window to at most the
+// pushes it had, so the push count never rises.
+//
+// Anything that does not replay as a solution comes back unchanged.
+class SolutionOptimizer {
+public:
+    static const int DEFAULT_WINDOW_PUSHES = 6;
+    static const int DEFAULT_WINDOW_NODES = 20000;
+    static const int MAX_PASSES = 4;
+    
+    SolutionOptimizer()
+        : context(nullptr), objective(OPTIMIZE_MOVES), windowPushes(DEFAULT_WINDOW_PUSHES),
+          windowNodes(DEFAULT_WINDOW_NODES), control(nullptr), movesBefore(0), pushesBefore(0), movesAfter(0),
+          pushesAfter(0), windowsImproved(0) {}
+    
+    void setObjective(OptimizerObjective goal) { objective = goal; }
+    OptimizerObjective getObjective() const { return objective; }
+    const char* getObjectiveName() const {
+        return objective == OPTIMIZE_PUSHES ? "moves, keeping pushes" : "moves, then pushes";
+    }
+    
+    void setWindowPushes(int pushes) { windowPushes = std::max(1, pushes); }
+    void setWindowNodes(int nodes) { windowNodes = nodes; }
+    
+    // Cancelling stops at the next window and keeps what was gained.
+    void setControl(SolverControl* shared) { control = shared; }
+    
+    std::string optimize(const SolverContext& prepared, const Level& level, int playerX, int playerY,
+                         const std::string& solution) {
+        context = &prepared;
+        windowsImproved = 0;
+        movesBefore = movesAfter = solution.size();
+        pushesBefore = pushesAfter = 0;
+        
+        PackedState start;
+        if (!context->packState(level, playerX, playerY, start) || !splitPushes(start, solution, pushes)) {
+            std::cout << "Optimizer: solution does not replay, left as is" << std::endl;
+            return solution;
+        }
+        pushesBefore = pushesAfter = pushes.size();
+        
+        replayPositions(start);
+        int step = std::max(1, windowPushes / 2);
+        for (int pass = 0; pass < MAX_PASSES; pass++) {
+            bool improved = false;
+            for (size_t first = 0; first < pushes.size() && !(control && control->cancelled()); first += step) {
+                size_t last = std::min(pushes.size(), first + windowPushes);
+                if (improveWindow(first, last)) {
+                    replayPositions(start);
+                    improved = true;
+                    windowsImproved++;
+                }
+            }
+            if (!improved) {
+                break;
+            }
+        }
+        
+        std::string result = joinWithWalks(start);
+        std::vector<PushMove> check;
+        if (result.empty() || !splitPushes(start, result, check) || !isNoWorse(check.size(), result.size(),
+                                                                              pushesBefore, solution.size())) {
+            return solution;
+        }
+        
+        movesAfter = result.size();
+        pushesAfter = check.size();
+        return result;
+    }
+    
+    int getMovesBefore() const { return movesBefore; }
+    int getPushesBefore() const { return pushesBefore; }
+    int getMovesAfter() const { return movesAfter; }
+    int getPushesAfter() const { return pushesAfter; }
+    int getWindowsImproved() const { return windowsImproved; }
+
+private:
+    struct WindowNode {
+        PackedState packed;
+        int parent;
+        PushMove push;
+        int moves;
+        int pushCount;
+    };
+    
+    // Open list order: fewest moves plus the push bound, then fewest pushes.
+    struct OpenEntry {
+        int f;
+        int pushCount;
+        int node;
+        
+        bool operator>(const OpenEntry& other) const {
+            if (f != other.f) return f > other.f;
+            return pushCount > other.pushCount;
+        }
+    };
+    
+    const SolverContext* context;
+    OptimizerObjective objective;
+    int windowPushes;
+    int windowNodes;
+    SolverControl* control;
+    
+    std::vector<PushMove> pushes;
+    std::vector<PackedState> positions;     // positions[i] is the board before pushes[i]
+    std::vector<WindowNode> nodes;
+    std::vector<uint16_t> goalDistances;
+    std::vector<int> walkDistance;
+    std::vector<int> cellQueue;
+    BoxMatching matching;
+    
+    int movesBefore;
+    int pushesBefore;
+    int movesAfter;
+    int pushesAfter;
+    int windowsImproved;
+    
+    static int opposite(int dir) { return (dir + 2) % 4; }
+    
+    // True unless (pushes, moves) is worse than the old pair under the
+    // objective; equal counts as no worse.
+    bool isNoWorse(size_t pushCount, size_t moves, size_t oldPushes, size_t oldMoves) const {
+        if (objective == OPTIMIZE_PUSHES) {
+            return std::make_pair(pushCount, moves) <= std::make_pair(oldPushes, oldMoves);
+        }
+        return std::make_pair(moves, pushCount) <= std::make_pair(oldMoves, oldPushes);
+    }
+    
+    // Replays the moves and collects the pushes; false if a move is
+    // illegal or the boxes do not all end on targets.
+    bool splitPushes(const PackedState& start, const std::string& moves, std::vector<PushMove>& out) const {
+        static const std::string dirChars = "URDL";
+        out.clear();
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        
+        for (char move : moves) {
+            size_t dir = dirChars.find(move);
+            if (dir == std::string::npos) {
+                return false;
+            }
+            int next = context->neighbour(player, dir);
+            if (next < 0) {
+                return false;
+            }
+            if (boxes.test(next)) {
+                int to = context->neighbour(next, dir);
+                if (to < 0 || boxes.test(to)) {
+                    return false;
+                }
+                boxes.reset(next);
+                boxes.set(to);
+                out.push_back(PushMove(next, dir));
+            }
+            player = next;
+        }
+        
+        return boxes.isSubsetOf(context->targets);
+    }
+    
+    void replayPositions(const PackedState& start) {
+        positions.assign(1, start);
+        for (const PushMove& push : pushes) {
+            PackedState next = positions.back();
+            next.boxes.reset(push.box);
+            next.boxes.set(context->neighbour(push.box, push.dir));
+            next.player = push.box;
+            positions.push_back(next);
+        }
+    }
+    
+    // Fills walkDistance with the length of the shortest walk from `from`
+    // to every cell, boxes in the way; -1 where there is none.
+    void computeWalks(const BoxSet& boxes, int from) {
+        walkDistance.assign(context->floorCount, -1);
+        cellQueue.assign(1, from);
+        walkDistance[from] = 0;
+        
+        for (size_t head = 0; head < cellQueue.size(); head++) {
+            int cell = cellQueue[head];
+            for (int dir = 0; dir < 4; dir++) {
+                int next = context->neighbour(cell, dir);
+                if (next >= 0 && walkDistance[next] < 0 && !boxes.test(next)) {
+                    walkDistance[next] = walkDistance[cell] + 1;
+                    cellQueue.push_back(next);
+                }
+            }
+        }
+    }
+    
+    // Moves the current pushes [first, last) take, counting the walk to the
+    // push after them.
+    int windowMoves(size_t first, size_t last) {
+        int moves = 0;
+        for (size_t i = first; i <= last && i < pushes.size(); i++) {
+            computeWalks(positions[i].boxes, positions[i].player);
+            moves += walkDistance[context->neighbour(pushes[i].box, opposite(pushes[i].dir))];
+            if (i < last) {
+                moves++;
+            }
+        }
+        return moves;
+    }
+    
+    // Best-first search for a cheaper way through the window. Pushes are
+    // edges costing their walk plus one; the matching over push distances
+    // to the window's final boxes bounds the pushes, and so the moves, left.
+    bool improveWindow(size_t first, size_t last) {
+        const BoxSet& goalBoxes = positions[last].boxes;
+        int nextFrom = last < pushes.size() ? context->neighbour(pushes[last].box, opposite(pushes[last].dir)) : -1;
+        int bestMoves = windowMoves(first, last);
+        int bestPushes = last - first;
+        // With OPTIMIZE_PUSHES, the matching also bounds the pushes left.
+        int windowPushCount = last - first;
+        
+        std::vector<int> goalCells;
+        for (int cell = goalBoxes.next(0); cell >= 0; cell = goalBoxes.next(cell + 1)) {
+            goalCells.push_back(cell);
+        }
+        context->computePushDistancesTo(goalCells, goalDistances);
+        
+        nodes.clear();
+        std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+        std::unordered_map<uint64_t, int> bestSeen;
+        
+        WindowNode root;
+        root.packed = positions[first];
+        root.parent = -1;
+        root.moves = 0;
+        root.pushCount = 0;
+        nodes.push_back(root);
+        open.push(OpenEntry{0, 0, 0});
+        int bestNode = -1;
+        
+        while (!open.empty() && (int)nodes.size() < windowNodes) {
+            OpenEntry entry = open.top();
+            open.pop();
+            if (entry.f > bestMoves) {
+                break;
+            }
+            
+            WindowNode current = nodes[entry.node];
+            computeWalks(current.packed.boxes, current.packed.player);
+            
+            if (current.packed.boxes == goalBoxes) {
+                int tail = nextFrom >= 0 ? walkDistance[nextFrom] : 0;
+                if (tail >= 0) {
+                    int moves = current.moves + tail;
+                    if (moves < bestMoves || (moves == bestMoves && current.pushCount < bestPushes)) {
+                        bestMoves = moves;
+                        bestPushes = current.pushCount;
+                        bestNode = entry.node;
+                    }
+                }
+                continue;
+            }
+            
+            uint64_t key = stateKey(current.packed);
+            auto seen = bestSeen.find(key);
+            if (seen != bestSeen.end() && seen->second <= current.moves) {
+                continue;
+            }
+            bestSeen[key] = current.moves;
+            
+            const BoxSet& boxes = current.packed.boxes;
+            for (int box = boxes.next(0); box >= 0; box = boxes.next(box + 1)) {
+                for (int dir = 0; dir < 4; dir++) {
+                    int from = context->neighbour(box, opposite(dir));
+                    int to = context->neighbour(box, dir);
+                    if (from < 0 || walkDistance[from] < 0 || to < 0 || boxes.test(to) || context->isDead(to)) {
+                        continue;
+                    }
+                    
+                    WindowNode child;
+                    child.packed.boxes = boxes;
+                    child.packed.boxes.reset(box);
+                    child.packed.boxes.set(to);
+                    child.packed.player = box;
+                    child.parent = entry.node;
+                    child.push = PushMove(box, dir);
+                    child.moves = current.moves + walkDistance[from] + 1;
+                    child.pushCount = current.pushCount + 1;
+                    
+                    matching.assign(goalDistances, goalCells.size(), context->floorCount, child.packed.boxes);
+                    int h = matching.cost();
+                    if (h >= BoxMatching::INFINITE_COST || child.moves + h > bestMoves ||
+                        (objective == OPTIMIZE_PUSHES && child.pushCount + h > windowPushCount)) {
+                        continue;
+                    }
+                    
+                    nodes.push_back(child);
+                    open.push(OpenEntry{child.moves + h, child.pushCount, (int)nodes.size() - 1});
+                }
+            }
+        }
+        
+        if (bestNode < 0) {
+            return false;
+        }
+        
+        std::vector<PushMove> replacement;
+        for (int node = bestNode; nodes[node].parent >= 0; node = nodes[node].parent) {
+            replacement.push_back(nodes[node].push);
+        }
+        std::reverse(replacement.begin(), replacement.end());
+        pushes.erase(pushes.begin() + first, pushes.begin() + last);
+        pushes.insert(pushes.begin() + first, replacement.begin(), replacement.end());
+        return true;
+    }
+    
+    uint64_t stateKey(const PackedState& packed) const {
+        uint64_t key = context->zobrist.playerKeys[packed.player];
+        for (int box = packed.boxes.next(0); box >= 0; box = packed.boxes.next(box + 1)) {
+            key ^= context->zobrist.boxKeys[box];
+        }
+        return key;
+    }
+    
+    // Shortest walks between the pushes, as a LURD string.
+    std::string joinWithWalks(const PackedState& start) const {
+        static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+        BoxSet boxes = start.boxes;
+        int player = start.player;
+        std::string result;
+        std::string walk;
+        
+        for (const PushMove& push : pushes) {
+            int from = context->neighbour(push.box, opposite(push.dir));
+            if (from < 0 || !context->findWalk(boxes, player, from, walk)) {
+                return "";
+            }
+            result += walk;
+            result += dirChars[push.dir];
+            boxes.reset(push.box);
+            boxes.set(context->neighbour(push.box, push.dir));
+            player = push.box;
+        }
+        
+        return result;
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "game_structures.h"
+#include "solver.h"
+#include "solver_control.h"
+
+// Live figures of a running solve, read without locking.
+struct SolveProgress {
+    bool running;
+    long long nodes;
+    long long nodesPerSecond;
+    long long frontier;
+    int bestH;
+    int elapsedMs;
+};
+
+// One solve: the board snapshot, the worker thread and everything that
+// thread reads or writes. Kept apart from SolveJob so a cancelled run can
+// wind down while the next one starts.
+struct SolveRun {
+    Level snapshot;
+    // Held for the whole run, so loading another level cannot free it.
+    std::shared_ptr<const SolverContext> prepared;
+    DeadlockPatterns patterns;
+    int startX;
+    int startY;
+    std::thread worker;
+    SolverControl control;
+    std::atomic<bool> done;
+    std::vector<char> result;
+    SolveStats resultStats;
+    std::chrono::steady_clock::time_point startTime;
+    
+    SolveRun() : startX(0), startY(0), done(false) {}
+};
+
+// Solves a snapshot of the board on a worker thread so the window keeps
+// drawing. The main thread starts the job, may cancel it, reads its
+// progress each frame and collects the result once it is done.
+class SolveJob {
+public:
+    SolveJob();
+    ~SolveJob();
+    
+    SolveJob(const SolveJob&) = delete;
+    SolveJob& operator=(const SolveJob&) = delete;
+    
+    // Starts solving a copy of `level` with the player at (playerX,
+    // playerY). An earlier job that was cancelled but not yet collected is
+    // set aside to finish on its own; reap() later takes its patterns.
+    // False while an earlier job is still running and not cancelled, or
+    // while another cancelled job is still winding down.
+    bool start(const Level& level, int playerX, int playerY);
+    
+    // Asks the search to stop at its next budget check and returns at
+    // once. The job then finishes as cancelled, which can take a while if
+    // it is merging files or optimizing a solution.
+    void cancel();
+    
+    // Cancels the job and any job set aside, and waits for both threads,
+    // dropping their results.
+    void stop();
+    
+    // Joins a job set aside by start() once it has finished and merges
+    // the deadlock patterns it learned into deadlockPatternStore. Returns
+    // how many were new; never blocks.
+    int reap();
+    
+    // True from start() until collect() has taken the result.
+    bool active() const { return current && current->worker.joinable(); }
+    
+    // True if the board still matches the snapshot being solved.
+    bool matches(const Level& level) const;
+    
+    // Where the player stood in the snapshot.
+    int getStartX() const { return current ? current->startX : 0; }
+    int getStartY() const { return current ? current->startY : 0; }
+    
+    SolveProgress progress() const;
+    
+    // Once the job has finished, hands over its result and returns true.
+    // Deadlock patterns the search learned go to deadlockPatternStore,
+    // whether or not it was cancelled; stats.patternsLearned counts them.
+    bool collect(std::vector<char>& solution, SolveStats& stats);
+
+private:
+    static void run(SolveRun* job);
+    
+    // The job start() last began, kept after collect() for matches() and
+    // the start position; and a cancelled one still winding down.
+    std::unique_ptr<SolveRun> current;
+    std::unique_ptr<SolveRun> retiring;
+};
+
+extern SolveJob solveJob;
@@ -5,11 +5,58 @@
 #include <chrono>
 #include "game_structures.h"
 #include "advanced_solver.h"
+#include "solver_control.h"
+#include "deadlock_patterns.h"
 
 extern int solverNodesExplored;
 extern int solverMaxQueueSize;
 extern int solverExecutionTimeMs;
 
+// Search used by solveSokoban and solveLevel.
+enum SolverEngine {
+    SOLVER_ENGINE_ASTAR,
+    SOLVER_ENGINE_PARALLEL,     // hash-distributed A* on solverThreadCount threads
+    SOLVER_ENGINE_BIDIRECTIONAL,
+    SOLVER_ENGINE_EXTERNAL,     // breadth-first over pushes, states kept on disk
+    SOLVER_ENGINE_PORTFOLIO     // several engines raced; see PortfolioSolver
+};
+
+extern SolverEngine solverEngine;
+
+// Worker threads for the parallel engine; zero means one per core.
+extern int solverThreadCount;
+
+// Tunnel and goal-room macro moves for the single-threaded A* engine; see
+// AdvancedSolver::setMacroMoves.
+extern bool solverMacroMoves;
+
+// Whether the portfolio engine lets its push-optimal racers run on after
+// the first solution; see PortfolioSolver::setImprove.
+extern bool solverPortfolioImprove;
+
+// Figures from one solve besides the moves themselves.
+struct SolveStats {
+    int nodesExplored;
+    int maxQueueSize;
+    int executionTimeMs;
+    bool cancelled;
+    int patternsLearned;
+    
+    SolveStats() : nodesExplored(0), maxQueueSize(0), executionTimeMs(0), cancelled(false), patternsLearned(0) {}
+};
+
+// Runs the selected engine, then IDA* if that one runs out of memory.
+// `prepared`, `control` and `patterns` may be null; the A* and portfolio
+// engines add the deadlocks they prove to `patterns`, the others only prune
+// with them. It reads the engine settings but writes no globals, so it is
+// safe to call off the main thread.
+std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, const SolverContext* prepared,
+                                          SolverControl* control, DeadlockPatterns* patterns, SolveStats& stats);
+
+// The original signature, kept for existing callers: solves like
+// solveSokoban, with the level's stored patterns and no shared control.
+std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize);
+
 std::vector<char> solveSokoban(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize);
 
 bool solveLevel(Level& level, std::vector<char>& solution, int& nodesExplored, int& maxQueueSize);
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Bump allocator for one search. Memory comes from large blocks and is never
+// freed piece by piece; release() hands every block back at once, so a solve
+// leaves no fragmented heap behind.
+class SolverArena {
+public:
+    static const size_t BLOCK_SIZE = 1 << 20;
+    
+    SolverArena() : cursor(nullptr), remaining(0), reserved(0), used(0) {}
+    ~SolverArena() { release(); }
+    
+    SolverArena(const SolverArena&) = delete;
+    SolverArena& operator=(const SolverArena&) = delete;
+    
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        size_t padding = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        if (!cursor || padding + size > remaining) {
+            size_t blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            char* block = static_cast<char*>(std::malloc(blockSize));
+            if (!block) {
+                throw std::bad_alloc();
+            }
+            blocks.push_back(block);
+            reserved += blockSize;
+            cursor = block;
+            remaining = blockSize;
+            padding = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        }
+        
+        char* result = cursor + padding;
+        cursor += padding + size;
+        remaining -= padding + size;
+        used += size;
+        return result;
+    }
+    
+    template<typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+    
+    void release() {
+        for (char* block : blocks) {
+            std::free(block);
+        }
+        blocks.clear();
+        cursor = nullptr;
+        remaining = 0;
+        reserved = 0;
+        used = 0;
+    }
+    
+    size_t bytesReserved() const { return reserved; }
+    size_t bytesUsed() const { return used; }
+
+private:
+    std::vector<char*> blocks;
+    char* cursor;
+    size_t remaining;
+    size_t reserved;
+    size_t used;
+};
+
+// Append-only table of trivially copyable items stored in fixed-size arena
+// chunks. Indices stay valid and items never move while the arena lives.
+template<typename T>
+class ArenaTable {
+public:
+    static const size_t CHUNK_ITEMS = 4096;
+    
+    explicit ArenaTable(SolverArena& arena) : arena(arena), count(0) {}
+    
+    int push(const T& item) {
+        if (count % CHUNK_ITEMS == 0) {
+            chunks.push_back(arena.allocateArray<T>(CHUNK_ITEMS));
+        }
+        chunks[count / CHUNK_ITEMS][count % CHUNK_ITEMS] = item;
+        return static_cast<int>(count++);
+    }
+    
+    T& operator[](size_t index) { return chunks[index / CHUNK_ITEMS][index % CHUNK_ITEMS]; }
+    const T& operator[](size_t index) const { return chunks[index / CHUNK_ITEMS][index % CHUNK_ITEMS]; }
+    
+    size_t size() const { return count; }
+    
+    // Forgets the items; their memory goes back with the arena.
+    void clear() {
+        chunks.clear();
+        count = 0;
+    }
+
+private:
+    SolverArena& arena;
+    std::vector<T*> chunks;
+    size_t count;
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <memory>
+#include "game_structures.h"
+
+struct Position {
+    int x, y;
+    
+    Position(int x = 0, int y = 0) : x(x), y(y) {}
+    
+    bool operator==(const Position& other) const {
+        return x == other.x && y == other.y;
+    }
+    
+    bool operator!=(const Position& other) const {
+        return !(*this == other);
+    }
+    
+    bool operator<(const Position& other) const {
+        if (x != other.x) return x < other.x;
+        return y < other.y;
+    }
+};
+
+namespace std {
+    template<>
+    struct hash<Position> {
+        size_t operator()(const Position& pos) const {
+            return hash<int>()(pos.x) ^ (hash<int>()(pos.y) << 1);
+        }
+    };
+}
+
+// Floor cells are numbered in row-major order, so the lowest index of a
+// region is also its top-left cell. Larger levels are left to BoardSolver.
+const int MAX_FLOOR_CELLS = 256;
+const int BOX_SET_WORDS = MAX_FLOOR_CELLS / 64;
+
+// Box occupancy over the floor cells of one level, one bit per cell.
+struct BoxSet {
+    uint64_t words[BOX_SET_WORDS];
+    
+    BoxSet() { clear(); }
+    
+    void clear() { std::memset(words, 0, sizeof(words)); }
+    
+    bool test(int cell) const { return (words[cell >> 6] >> (cell & 63)) & 1; }
+    void set(int cell) { words[cell >> 6] |= 1ULL << (cell & 63); }
+    void reset(int cell) { words[cell >> 6] &= ~(1ULL << (cell & 63)); }
+    
+    int count() const {
+        int total = 0;
+        for (int i = 0; i < BOX_SET_WORDS; i++) {
+            total += __builtin_popcountll(words[i]);
+        }
+        return total;
+    }
+    
+    // First set cell at or after `from`, or -1.
+    int next(int from) const {
+        if (from >= MAX_FLOOR_CELLS) return -1;
+        int word = from >> 6;
+        uint64_t bits = words[word] & (~0ULL << (from & 63));
+        while (true) {
+            if (bits) return (word << 6) + __builtin_ctzll(bits);
+            if (++word >= BOX_SET_WORDS) return -1;
+            bits = words[word];
+        }
+    }
+    
+    bool isSubsetOf(const BoxSet& other) const {
+        for (int i = 0; i < BOX_SET_WORDS; i++) {
+            if (words[i] & ~other.words[i]) return false;
+        }
+        return true;
+    }
+    
+    bool operator==(const BoxSet& other) const {
+        return std::memcmp(words, other.words, sizeof(words)) == 0;
+    }
+    
+    bool operator!=(const BoxSet& other) const {
+        return !(*this == other);
+    }
+};
+
+// Everything that changes during a search: where the boxes are and which
+// floor cell the player is on.
+struct PackedState {
+    BoxSet boxes;
+    uint16_t player;
+    
+    PackedState() : player(0) {}
+    
+    bool operator==(const PackedState& other) const {
+        return player == other.player && boxes == other.boxes;
+    }
+};
+
+// One box push in push-level search: the box's floor cell before the push
+// and the push direction. The walk leading up to it is rebuilt afterwards.
+struct PushMove {
+    int box;
+    int dir;
+    
+    PushMove(int box = 0, int dir = 0) : box(box), dir(dir) {}
+};
+
+// Move codes stored per node: the direction in step mode, and
+// box cell * 4 + direction in push mode.
+inline uint32_t encodePushMove(const PushMove& push) {
+    return static_cast<uint32_t>(push.box) * 4 + push.dir;
+}
+
+inline PushMove decodePushMove(uint32_t move) {
+    return PushMove(move / 4, move % 4);
+}
+
+// Random 64-bit keys per (cell, box) and (cell, player). A state key is the
+// XOR of the keys of its occupied cells, so a move or push updates it with
+// two or four XORs. The check keys come from a separate stream and are
+// compared whenever two primary keys match.
+struct ZobristTable {
+    std::vector<uint64_t> boxKeys;
+    std::vector<uint64_t> playerKeys;
+    std::vector<uint64_t> boxCheckKeys;
+    std::vector<uint64_t> playerCheckKeys;
+    
+    void init(int cellCount);
+};
+
+// A dead end of the floor holding targets, which a box can only enter by
+// one push, from `outside` onto `entrance`. Its targets are filled in a
+// fixed order that keeps the rest of them reachable, so a box pushed in
+// is taken straight to the next target on a precomputed path.
+struct GoalRoom {
+    int outside;
+    int entrance;
+    int dir;
+    BoxSet cells;
+    std::vector<int> order;                     // targets in the order they are filled
+    std::vector<BoxSet> filled;                 // filled[k]: the first k targets of order
+    std::vector<std::vector<PushMove>> paths;   // paths[k]: pushes from the entrance onto order[k]
+};
+
+// A reflection or rotation of the floor that maps the floor and the
+// targets onto themselves. Two states it maps onto each other need the
+// same number of moves and pushes.
+struct Symmetry {
+    std::vector<int> cells;     // floor cell -> its image
+    int dirs[4];                // direction -> its image
+};
+
+// Static data of one level shared by every node of a search: the floor
+// cells the player can ever reach, their neighbours, the targets, the dead
+// squares, the push distances and the Zobrist keys. Nodes only store a
+// PackedState against it.
+class SolverContext {
+public:
+    static const uint16_t UNREACHABLE = 0xFFFF;
+    
+    // Larger dead ends are not treated as goal rooms: packing one in a
+    // fixed order would cost more than it saves.
+    static const int MAX_GOAL_ROOM_CELLS = 64;
+    
+    int width;
+    int height;
+    int floorCount;
+    std::vector<int> cellAt;           // board index (y * width + x) -> floor cell or -1
+    std::vector<Position> cellPos;     // floor cell -> board position
+    std::vector<int> neighbours;       // floor cell * 4 + dir -> floor cell or -1
+    BoxSet targets;
+    std::vector<int> targetCells;
+    BoxSet deadSquares;                // cells a lone box can never be pushed to a target from
+    std::vector<uint8_t> sideGroups;   // floor cell * 4 + dir -> which sides of a box there connect, 0xFF = wall
+    std::vector<uint16_t> pushDistances; // target index * floorCount + cell -> pushes, or UNREACHABLE
+    BoxSet tunnels[4];                 // per direction: cells a box pushed that way is walled in on
+    std::vector<GoalRoom> goalRooms;
+    std::vector<int> roomEntries;      // floor cell * 4 + dir -> goal room a push from there enters, or -1
+    std::vector<Symmetry> symmetries;  // every symmetry of the level but the identity
+    ZobristTable zobrist;
+    
+    SolverContext() : width(0), height(0), floorCount(0) {}
+    
+    // Indexes the floor reachable from the player's cell, ignoring boxes.
+    // Fails if the level has more than MAX_FLOOR_CELLS floor cells.
+    bool build(const Level& level, int playerX, int playerY);
+    
+    // Reads boxes from level.currentMap. Fails if a box sits off the floor.
+    bool packState(const Level& level, int playerX, int playerY, PackedState& state) const;
+    
+    int cellOf(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) return -1;
+        return cellAt[y * width + x];
+    }
+    
+    int neighbour(int cell, int dir) const { return neighbours[cell * 4 + dir]; }
+    bool isTarget(int cell) const { return targets.test(cell); }
+    bool isDead(int cell) const { return deadSquares.test(cell); }
+    
+    // Fewest pushes that bring a lone box from `cell` onto the given target.
+    int pushDistance(int targetIndex, int cell) const {
+        return pushDistances[targetIndex * floorCount + cell];
+    }
+    
+    // The same table as pushDistances for any list of goal cells:
+    // table[i * floorCount + cell] is the fewest pushes that bring a lone
+    // box from `cell` to goals[i].
+    void computePushDistancesTo(const std::vector<int>& goals, std::vector<uint16_t>& table) const;
+    
+    // The other way round: fills table[i * floorCount + cell] with the
+    // fewest pushes that bring a lone box from sources[i] to `cell`, which
+    // is also the fewest pulls from `cell` back to sources[i].
+    void computePushDistancesFrom(const std::vector<int>& sources, std::vector<uint16_t>& table) const;
+    
+    // Makes `hash` and `check`, the Zobrist keys of `state`, the same for
+    // every state a symmetry maps it onto: the smallest primary key over
+    // the images, with its check key. With `region`, the player's reachable
+    // area, each image's player is the lowest cell of the mapped area, as
+    // push search numbers it; without, the player's own cell is mapped.
+    void canonicalKeys(const PackedState& state, const std::vector<char>* region, uint64_t& hash,
+                       uint64_t& check) const;
+    
+    // Run after every push, on the pushed box only: true when the push froze
+    // the box, or a cluster around it, with a box off its target.
+    bool isFreezeDeadlock(const BoxSet& boxes, int cell) const;
+    
+    // The pushes that make up one macro move, `push` first. A box pushed
+    // into a tunnel, a one-wide corridor with the player behind it, is
+    // pushed on until it leaves the corridor or meets an obstacle; a box
+    // pushed into a goal room whose targets are filled up to some point in
+    // its order is pushed on to the next one. Otherwise just `push`.
+    // `boxes` is the position before the push.
+    void expandPush(const BoxSet& boxes, const PushMove& push, std::vector<PushMove>& pushes) const;
+    
+    // Boxes on the targets of goal rooms filled in order so far. Their room
+    // is being packed, so a search need not push them again.
+    void packedRoomBoxes(const BoxSet& boxes, BoxSet& packed) const;
+    
+    // Shortest player walk between two cells, boxes treated as obstacles, as
+    // a string of 'U', 'R', 'D', 'L'.
+    bool findWalk(const BoxSet& boxes, int from, int to, std::string& walk) const;
+
+private:
+    void computeDeadSquares();
+    void computeSideGroups();
+    void computePushDistances();
+    void computeTunnels();
+    void computeGoalRooms();
+    void computeSymmetries();
+    bool findRoomPath(const GoalRoom& room, const BoxSet& obstacles, int target, std::vector<PushMove>& path) const;
+    int roomProgress(const GoalRoom& room, const BoxSet& boxes) const;
+    bool isFrozen(const BoxSet& boxes, int cell, BoxSet& onPath, bool& offTarget) const;
+};
+
+// Plays LURD moves from (playerX, playerY) with the boxes of
+// level.currentMap. True if every move is legal and every box ends on a
+// target; `pushes` receives the number of pushes made.
+bool replaySolution(const Level& level, int playerX, int playerY, const std::string& moves, int& pushes);
+
+// Returns the context for the level's walls, targets and start position,
+// building it unless it is the one prepared last. Only that one is kept;
+// whoever still holds an older one keeps it alive. Call it when a level is
+// loaded so that solves find the tables ready. Returns null if the level
+// cannot be indexed.
+std::shared_ptr<const SolverContext> prepareLevelContext(const Level& level);
+
+// Floor cells the player can walk to from (playerX, playerY) on an empty
+// board, which build() would index; 0 if the player is on a wall.
+int countFloorCells(const Level& level, int playerX, int playerY);
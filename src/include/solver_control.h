@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+
+// Milliseconds on a steady clock. The solvers time themselves with it
+// rather than SDL_GetTicks, so they also run without SDL.
+inline long long solverClockMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Shared between a running search and the thread that started it. The
+// owner raises `cancel`; the search polls it every few hundred nodes and
+// adds its progress to the counters. Everything is a lock-free atomic, so
+// neither side ever waits for the other.
+struct SolverControl {
+    std::atomic<bool> cancel;
+    std::atomic<long long> nodes;
+    std::atomic<long long> frontier;
+    std::atomic<int> bestH;
+    
+    SolverControl() : cancel(false), nodes(0), frontier(0), bestH(INT_MAX) {}
+    
+    void reset() {
+        cancel = false;
+        nodes = 0;
+        frontier = 0;
+        bestH = INT_MAX;
+    }
+    
+    bool cancelled() const { return cancel.load(std::memory_order_relaxed); }
+};
+
+// One search thread's view of a SolverControl. It remembers what it last
+// added, so several threads, or several searches run one after another,
+// can each report running totals and the shared counters still add up.
+class ProgressReporter {
+public:
+    ProgressReporter() : control(nullptr), nodes(0), frontier(0) {}
+    
+    void attach(SolverControl* shared) {
+        control = shared;
+        nodes = 0;
+        frontier = 0;
+    }
+    
+    bool cancelled() const { return control && control->cancelled(); }
+    
+    // Totals for this thread so far: nodes expanded, states waiting, and
+    // the heuristic of the state just taken.
+    void report(long long nodeTotal, long long frontierSize, int h) {
+        if (!control) {
+            return;
+        }
+        control->nodes.fetch_add(nodeTotal - nodes, std::memory_order_relaxed);
+        control->frontier.fetch_add(frontierSize - frontier, std::memory_order_relaxed);
+        nodes = nodeTotal;
+        frontier = frontierSize;
+        
+        int best = control->bestH.load(std::memory_order_relaxed);
+        while (h < best && !control->bestH.compare_exchange_weak(best, h, std::memory_order_relaxed)) {
+        }
+    }
+    
+    // Takes this thread's states back out of the frontier once it stops.
+    void finish() {
+        report(nodes, 0, INT_MAX);
+        control = nullptr;
+    }
+
+private:
+    SolverControl* control;
+    long long nodes;
+    long long frontier;
+};
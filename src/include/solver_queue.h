@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Open list for small integer f-values. There is one bucket per f, split by
+// h so that ties on f go to the node with the lowest h, i.e. the deepest one;
+// nodes with equal (f, h) come out last in, first out. Push and pop are O(1)
+// apart from skipping over emptied buckets.
+class BucketQueue {
+public:
+    BucketQueue() : minF(0), count(0) {}
+    
+    void push(int handle, int f, int h) {
+        if (f >= (int)buckets.size()) {
+            buckets.resize(f + 1);
+            minH.resize(f + 1, 0);
+        }
+        std::vector<std::vector<int>>& bucket = buckets[f];
+        if (h >= (int)bucket.size()) {
+            bucket.resize(h + 1);
+        }
+        
+        bucket[h].push_back(handle);
+        if (count == 0 || f < minF) minF = f;
+        if (bucket[h].size() == 1 && h < minH[f]) minH[f] = h;
+        count++;
+    }
+    
+    // Removes and returns the best handle, or -1 when empty.
+    int pop() {
+        if (count == 0) {
+            return -1;
+        }
+        
+        while (true) {
+            std::vector<std::vector<int>>& bucket = buckets[minF];
+            int& h = minH[minF];
+            while (h < (int)bucket.size() && bucket[h].empty()) {
+                h++;
+            }
+            if (h < (int)bucket.size()) {
+                int handle = bucket[h].back();
+                bucket[h].pop_back();
+                count--;
+                return handle;
+            }
+            h = 0;
+            minF++;
+        }
+    }
+    
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    
+    void clear() {
+        buckets.clear();
+        minH.clear();
+        minF = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<std::vector<std::vector<int>>> buckets;
+    std::vector<int> minH;
+    int minF;
+    size_t count;
+};
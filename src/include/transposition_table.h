@@ -0,0 +1,300 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Fixed-size table of searched states, sized once from a byte budget and
+// never grown. Entries sit in buckets of three that share one cache line.
+// When a bucket is full, a stale entry is replaced first: one from an
+// earlier search or iteration. After that the deepest entry goes, because
+// the states nearest the root are the most expensive to search again.
+//
+// newAge() starts over without clearing the table; stored entries simply
+// become stale. An optional Bloom filter answers most seen() misses without
+// touching the main table.
+class TranspositionTable {
+public:
+    static const int WAYS = 3;
+    
+    TranspositionTable()
+        : storage(nullptr), buckets(nullptr), bucketCount(0), bucketMask(0), age(1), count(0),
+          evictions(0), bloomMask(0) {}
+    ~TranspositionTable() { release(); }
+    
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+    
+    // Uses the largest power-of-two bucket count that fits in budgetBytes,
+    // plus a Bloom filter of about bloomBytes when that is non-zero.
+    void allocate(size_t budgetBytes, size_t bloomBytes = 0) {
+        release();
+        bucketCount = 1;
+        while (bucketCount * 2 * sizeof(Bucket) <= budgetBytes) {
+            bucketCount *= 2;
+        }
+        
+        // All-zero entries are stale, so zeroed pages from calloc are an
+        // empty table and untouched buckets cost no physical memory.
+        storage = std::calloc(bucketCount * sizeof(Bucket) + alignof(Bucket), 1);
+        if (!storage) {
+            throw std::bad_alloc();
+        }
+        uintptr_t address = reinterpret_cast<uintptr_t>(storage);
+        address = (address + alignof(Bucket) - 1) / alignof(Bucket) * alignof(Bucket);
+        buckets = reinterpret_cast<Bucket*>(address);
+        bucketMask = bucketCount - 1;
+        
+        size_t bloomWords = 0;
+        if (bloomBytes >= sizeof(uint64_t)) {
+            bloomWords = 1;
+            while (bloomWords * 2 * sizeof(uint64_t) <= bloomBytes) {
+                bloomWords *= 2;
+            }
+        }
+        bloom.assign(bloomWords, 0);
+        bloomMask = bloomWords ? bloomWords * 64 - 1 : 0;
+        
+        age = 1;
+        count = 0;
+        evictions = 0;
+    }
+    
+    bool allocated() const { return buckets != nullptr; }
+    
+    void release() {
+        std::free(storage);
+        storage = nullptr;
+        buckets = nullptr;
+        bucketCount = 0;
+        bucketMask = 0;
+        bloom.clear();
+    }
+    
+    void newAge() {
+        age++;
+        if (age == 0) {
+            std::memset(static_cast<void*>(buckets), 0, bucketCount * sizeof(Bucket));
+            age = 1;
+        }
+        std::fill(bloom.begin(), bloom.end(), 0);
+        count = 0;
+        evictions = 0;
+    }
+    
+    // Records the state as searched at depth g. Returns false if this age
+    // already holds it at depth g or less. Both 64-bit keys are stored and
+    // compared, so two states are only merged if both keys collide.
+    // `collision` is set when the primary key was present with a different
+    // check key; the state is then treated as new.
+    bool insert(uint64_t key, uint64_t check, int g, bool& collision) {
+        collision = false;
+        Bucket& bucket = buckets[key & bucketMask];
+        uint16_t depth = static_cast<uint16_t>(std::min(g, 0xFFFF));
+        
+        int victim = 0;
+        for (int way = 0; way < WAYS; way++) {
+            if (bucket.ages[way] == age && bucket.keys[way] == key) {
+                if (bucket.checks[way] == check) {
+                    if (bucket.depths[way] <= depth) {
+                        return false;
+                    }
+                    bucket.depths[way] = depth;
+                    return true;
+                }
+                collision = true;
+            }
+            if (worseThan(bucket, way, victim)) {
+                victim = way;
+            }
+        }
+        
+        if (bucket.ages[victim] == age) {
+            evictions++;
+        } else {
+            count++;
+        }
+        bucket.keys[victim] = key;
+        bucket.checks[victim] = check;
+        bucket.depths[victim] = depth;
+        bucket.ages[victim] = age;
+        markBloom(key);
+        return true;
+    }
+    
+    // True if this age holds the state at depth g or less, i.e. if
+    // insert() would turn it away.
+    bool seen(uint64_t key, uint64_t check, int g) const {
+        if (!inBloom(key)) {
+            return false;
+        }
+        const Bucket& bucket = buckets[key & bucketMask];
+        for (int way = 0; way < WAYS; way++) {
+            if (bucket.ages[way] == age && bucket.keys[way] == key && bucket.checks[way] == check) {
+                return bucket.depths[way] <= g;
+            }
+        }
+        return false;
+    }
+    
+    size_t size() const { return count; }
+    size_t getEvictions() const { return evictions; }
+    size_t capacity() const { return bucketCount * WAYS; }
+    size_t bytes() const { return bucketCount * sizeof(Bucket) + bloom.size() * sizeof(uint64_t); }
+    // Memory the current age has written to: its live entries and the
+    // Bloom filter. The rest of the allocation may never have been touched.
+    size_t bytesUsed() const { return count * sizeof(Bucket) / WAYS + bloom.size() * sizeof(uint64_t); }
+
+private:
+    // Fields are stored per column so that three full entries fit in 64
+    // bytes.
+    struct alignas(64) Bucket {
+        uint64_t keys[WAYS];
+        uint64_t checks[WAYS];
+        uint16_t depths[WAYS];
+        uint8_t ages[WAYS];
+    };
+    
+    // Stale entries are replaced before live ones, deeper before shallower.
+    bool worseThan(const Bucket& bucket, int a, int b) const {
+        bool staleA = bucket.ages[a] != age;
+        bool staleB = bucket.ages[b] != age;
+        if (staleA != staleB) {
+            return staleA;
+        }
+        return bucket.depths[a] > bucket.depths[b];
+    }
+    
+    void markBloom(uint64_t key) {
+        if (bloom.empty()) {
+            return;
+        }
+        size_t first = (key >> 20) & bloomMask;
+        size_t second = (key >> 40 | key << 24) & bloomMask;
+        bloom[first / 64] |= 1ULL << (first % 64);
+        bloom[second / 64] |= 1ULL << (second % 64);
+    }
+    
+    bool inBloom(uint64_t key) const {
+        if (bloom.empty()) {
+            return true;
+        }
+        size_t first = (key >> 20) & bloomMask;
+        size_t second = (key >> 40 | key << 24) & bloomMask;
+        return (bloom[first / 64] >> (first % 64) & 1) && (bloom[second / 64] >> (second % 64) & 1);
+    }
+    
+    void* storage;
+    Bucket* buckets;
+    size_t bucketCount;
+    size_t bucketMask;
+    uint8_t age;
+    size_t count;
+    size_t evictions;
+    std::vector<uint64_t> bloom;
+    size_t bloomMask;
+};
+
+// Fixed-size map from searched states to the node that expanded them, for
+// searches that have to find a state's node again. Sized once from a byte
+// budget like TranspositionTable, with three entries per cache line. A full
+// bucket gives up its newest entry, the one nearest the frontier.
+class StateNodeTable {
+public:
+    static const int WAYS = 3;
+    
+    StateNodeTable() : storage(nullptr), buckets(nullptr), bucketCount(0), bucketMask(0), count(0), evictions(0) {}
+    ~StateNodeTable() { release(); }
+    
+    StateNodeTable(const StateNodeTable&) = delete;
+    StateNodeTable& operator=(const StateNodeTable&) = delete;
+    
+    // Uses the largest power-of-two bucket count that fits in budgetBytes.
+    // The table starts out empty.
+    void allocate(size_t budgetBytes) {
+        release();
+        bucketCount = 1;
+        while (bucketCount * 2 * sizeof(Bucket) <= budgetBytes) {
+            bucketCount *= 2;
+        }
+        
+        storage = std::calloc(bucketCount * sizeof(Bucket) + alignof(Bucket), 1);
+        if (!storage) {
+            throw std::bad_alloc();
+        }
+        uintptr_t address = reinterpret_cast<uintptr_t>(storage);
+        address = (address + alignof(Bucket) - 1) / alignof(Bucket) * alignof(Bucket);
+        buckets = reinterpret_cast<Bucket*>(address);
+        bucketMask = bucketCount - 1;
+        count = 0;
+        evictions = 0;
+    }
+    
+    void release() {
+        std::free(storage);
+        storage = nullptr;
+        buckets = nullptr;
+        bucketCount = 0;
+        bucketMask = 0;
+        count = 0;
+    }
+    
+    // Node stored for the state, or -1.
+    int find(uint64_t key, uint64_t check) const {
+        const Bucket& bucket = buckets[key & bucketMask];
+        for (int way = 0; way < WAYS; way++) {
+            if (bucket.nodes[way] && bucket.keys[way] == key && bucket.checks[way] == check) {
+                return bucket.nodes[way] - 1;
+            }
+        }
+        return -1;
+    }
+    
+    // Records `node` for a state that find() does not know.
+    void insert(uint64_t key, uint64_t check, int node) {
+        Bucket& bucket = buckets[key & bucketMask];
+        int victim = 0;
+        for (int way = 0; way < WAYS; way++) {
+            if (!bucket.nodes[way]) {
+                victim = way;
+                break;
+            }
+            if (bucket.nodes[way] > bucket.nodes[victim]) {
+                victim = way;
+            }
+        }
+        
+        if (bucket.nodes[victim]) {
+            evictions++;
+        } else {
+            count++;
+        }
+        bucket.keys[victim] = key;
+        bucket.checks[victim] = check;
+        bucket.nodes[victim] = node + 1;
+    }
+    
+    size_t size() const { return count; }
+    size_t getEvictions() const { return evictions; }
+    size_t bytes() const { return bucketCount * sizeof(Bucket); }
+    size_t bytesUsed() const { return count * sizeof(Bucket) / WAYS; }
+
+private:
+    // Nodes are stored plus one, so that zero marks an empty entry.
+    struct alignas(64) Bucket {
+        uint64_t keys[WAYS];
+        uint64_t checks[WAYS];
+        int32_t nodes[WAYS];
+    };
+    
+    void* storage;
+    Bucket* buckets;
+    size_t bucketCount;
+    size_t bucketMask;
+    size_t count;
+    size_t evictions;
+};
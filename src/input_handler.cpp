@@ -5,10 +5,39 @@
 #include <string>
 
 #include "include/input_handler.h"
+#include "include/game_init.h"
 #include "include/game_structures.h"
 #include "include/solver.h"
+#include "include/solve_job.h"
+#include "include/solution_cache.h"
 #include "include/game_resources.h"
 
+// Plays a cached solution for the position at once if there is one;
+// otherwise starts a background solve.
+static void startSolver(int playerX, int playerY) {
+    std::vector<char> cached;
+    if (solutionCache.lookup(game.activeLevel, playerX, playerY, cached)) {
+        std::cout << "Solution loaded from cache: " << cached.size() << " moves" << std::endl;
+        solverRunning = false;
+        solverFoundSolution = true;
+        solverSolution = cached;
+        solverNodesExplored = 0;
+        solverMaxQueueSize = 0;
+        solverExecutionTimeMs = 0;
+        lastSolutionStepTime = SDL_GetTicks();
+    } else if (solveJob.start(game.activeLevel, playerX, playerY)) {
+        solverRunning = true;
+        solverFoundSolution = false;
+        solverSolution.clear();
+    } else {
+        return;
+    }
+    
+    solverActive = true;
+    currentSolutionStep = 0;
+    showSolverStats = true;
+}
+
 void handleInput(SDL_Event& event) {
     if (event.type != SDL_KEYDOWN) {
         return;
@@ -30,10 +59,7 @@ void handleInput(SDL_Event& event) {
             case SDLK_SPACE:
                 if (currentMenuSelection == MENU_START_GAME) {
                     currentLevelIndex = 0;
-                    if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-                        std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-                        exit(-1);
-                    }
+                    loadCurrentLevel();
                     game.moveHistory.clear();
                     game.isNewRecord = false;
                     
@@ -117,10 +143,7 @@ void handleInput(SDL_Event& event) {
                 
             case SDLK_RETURN:
             case SDLK_SPACE:
-                if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-                    std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-                    exit(-1);
-                }
+                loadCurrentLevel();
                 
                 game.moveHistory.clear();
                 game.isNewRecord = false;
@@ -238,10 +261,7 @@ void handleInput(SDL_Event& event) {
             currentLevelIndex++;
             
             if (currentLevelIndex < totalLoadedLevels) {
-                if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-                    std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-                    exit(-1);
-                }
+                loadCurrentLevel();
                 
                 game.moveHistory.clear();
                 game.isNewRecord = false;
@@ -298,10 +318,7 @@ void handleInput(SDL_Event& event) {
                     currentLevelIndex++;
                     game.moveHistory.clear();
                     game.isNewRecord = false;
-                    if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-                        std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-                        exit(-1);
-                    }
+                    loadCurrentLevel();
                     initializeLevel(&game.activeLevel, &game.player, game.activeLevel.playerStartX, game.activeLevel.playerStartY);
                 }
                 return;
@@ -310,10 +327,7 @@ void handleInput(SDL_Event& event) {
                     currentLevelIndex--;
                     game.moveHistory.clear();
                     game.isNewRecord = false;
-                    if (!loadLevelFromFile(dynamicLevelFiles[currentLevelIndex].c_str(), &game.activeLevel)) {
-                        std::cerr << "Error: Failed to load level from " << dynamicLevelFiles[currentLevelIndex] << std::endl;
-                        exit(-1);
-                    }
+                    loadCurrentLevel();
                     initializeLevel(&game.activeLevel, &game.player, game.activeLevel.playerStartX, game.activeLevel.playerStartY);
                 }
                 return;
@@ -322,45 +336,24 @@ void handleInput(SDL_Event& event) {
                 return;
             case SDLK_s:
                 if (!solverRunning) {
-                    solverRunning = true;
-                    solverActive = true;
-                    solverFoundSolution = false;
-                    solverSolution.clear();
-                    currentSolutionStep = 0;
-                    showSolverStats = true;
-
-                    Uint32 startTime = SDL_GetTicks();
-                    solverFoundSolution = solveLevel(game.activeLevel, solverSolution, solverNodesExplored, solverMaxQueueSize);
-                    solverExecutionTimeMs = SDL_GetTicks() - startTime;
-                    solverRunning = false;
+                    startSolver(game.activeLevel.playerStartX, game.activeLevel.playerStartY);
                 }
                 return;
             case SDLK_a:
+                // The job ends at its next budget check; updateGame then
+                // collects it and clears the solver state.
                 if (solverRunning) {
-                    solverRunning = false;
-                    solverActive = false;
-                    solverSolution.clear();
-                    currentSolutionStep = 0;
+                    solveJob.cancel();
                 }
                 return;
             case SDLK_F1:
                 if (!solverActive) {
-                    solverActive = true;
-                    solverRunning = true;
-                    solverFoundSolution = false;
-                    solverSolution.clear();
-                    currentSolutionStep = 0;
-                    showSolverStats = true;
-                    
-                    Uint32 startTime = SDL_GetTicks();
-                    solverSolution = solveSokoban(game.activeLevel, game.player.x, game.player.y, solverNodesExplored, solverMaxQueueSize);
-                    solverExecutionTimeMs = SDL_GetTicks() - startTime;
-                    solverRunning = false;
-                    solverFoundSolution = !solverSolution.empty();
+                    startSolver(game.player.x, game.player.y);
                 }
                 return;
 
             case SDLK_F3:
+                solveJob.cancel();
                 solverActive = false;
                 solverRunning = false;
                 solverFoundSolution = false;
@@ -2,6 +2,7 @@
 #include "include/game_structures.h"
 #include "include/texture_manager.h"
 #include "include/game_resources.h"
+#include "include/solve_job.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -12,6 +13,7 @@
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <climits>
 
 const Uint32 SOLUTION_STEP_DELAY = 300;
 
@@ -110,7 +112,7 @@ void renderSolverStatus(SDL_Renderer* renderer, TTF_Font* font) {
     }
     
     int lineCount = 1;
-    if (solverRunning) lineCount++;
+    if (solverRunning) lineCount += 2;
     else if (solverActive) {
         lineCount++;
         if (solverFoundSolution && solverSolution.size() > 0) lineCount++;
@@ -138,9 +140,18 @@ void renderSolverStatus(SDL_Renderer* renderer, TTF_Font* font) {
     yPos += 13;
 
     if (solverRunning) {
-        solverText = "Solver is running...";
+        solverText = "Solver is running... (A: cancel)";
         renderText(renderer, solverText.c_str(), 20, yPos, smallFont, activeColor);
         yPos += 13;
+        
+        SolveProgress progress = solveJob.progress();
+        std::string bestText = progress.bestH == INT_MAX ? "-" : std::to_string(progress.bestH);
+        std::string progressText = "Nodes: " + std::to_string(progress.nodes) +
+                                   " (" + std::to_string(progress.nodesPerSecond) + "/s)  Frontier: " +
+                                   std::to_string(progress.frontier) + "  Best h: " + bestText +
+                                   "  Time: " + std::to_string(progress.elapsedMs) + " ms";
+        renderText(renderer, progressText.c_str(), 20, yPos, smallFont, textColor);
+        yPos += 13;
     } else if (solverActive) {
         if (solverFoundSolution) {
             solverText = "Solution found! " + std::to_string(solverSolution.size()) + " moves";
@@ -0,0 +1,258 @@
+#include "include/solution_cache.h"
+#include "include/solver_context.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_set>
+#include <algorithm>
+
+SolutionCache solutionCache;
+const char* SOLUTION_CACHE_FILE = "solutions.dat";
+
+namespace {
+
+uint64_t mixHash(uint64_t hash, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+// Marks the tiles the player can walk to from (playerX, playerY) when boxes
+// are ignored.
+std::vector<char> playableTiles(const Level& level, int playerX, int playerY) {
+    std::vector<char> playable(level.width * level.height, 0);
+    if (playerX < 0 || playerY < 0 || playerX >= level.width || playerY >= level.height) {
+        return playable;
+    }
+    
+    std::vector<int> stack(1, playerY * level.width + playerX);
+    playable[stack[0]] = 1;
+    const int dx[4] = {0, 1, 0, -1};
+    const int dy[4] = {-1, 0, 1, 0};
+    
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        int x = index % level.width;
+        int y = index / level.width;
+        
+        for (int dir = 0; dir < 4; dir++) {
+            int nx = x + dx[dir];
+            int ny = y + dy[dir];
+            if (nx < 0 || ny < 0 || nx >= level.width || ny >= level.height) {
+                continue;
+            }
+            int next = ny * level.width + nx;
+            if (!playable[next] && level.originalMap[ny][nx] != WALL) {
+                playable[next] = 1;
+                stack.push_back(next);
+            }
+        }
+    }
+    
+    return playable;
+}
+
+bool isTargetTile(TileType tile) {
+    return tile == TARGET || tile == BOX_ON_TARGET || tile == PLAYER_ON_TARGET;
+}
+
+bool isBoxTile(TileType tile) {
+    return tile == BOX || tile == BOX_ON_TARGET;
+}
+
+// Board indices of the boxes in row-major order, then the player's.
+uint64_t positionHash(const std::vector<int>& boxes, int player) {
+    uint64_t hash = HASH_SEED;
+    for (int index : boxes) {
+        hash = mixHash(hash, index);
+    }
+    return mixHash(hash, (uint64_t)player | 1ULL << 32);
+}
+
+const char DIR_CHARS[4] = {'U', 'R', 'D', 'L'};
+
+// Maps every move through a direction table.
+std::string mapMoves(const std::string& moves, const int dirs[4]) {
+    std::string mapped = moves;
+    for (char& move : mapped) {
+        const char* dir = std::find(DIR_CHARS, DIR_CHARS + 4, move);
+        if (dir != DIR_CHARS + 4) {
+            move = DIR_CHARS[dirs[dir - DIR_CHARS]];
+        }
+    }
+    return mapped;
+}
+
+// Entries are keyed by the smallest position hash among the position and
+// its images under the level's symmetries, and their moves are stored as
+// played in that image, so a mirrored or rotated position finds them too.
+// `dirs` receives the image's direction mapping, copied out because the
+// level tables it comes from may be freed once this returns; it is the
+// identity for the position itself.
+uint64_t canonicalPositionHash(const Level& level, int playerX, int playerY, int dirs[4]) {
+    for (int dir = 0; dir < 4; dir++) {
+        dirs[dir] = dir;
+    }
+    uint64_t best = levelPositionHash(level, playerX, playerY);
+    std::shared_ptr<const SolverContext> context = prepareLevelContext(level);
+    if (!context || context->symmetries.empty() || context->cellOf(playerX, playerY) < 0) {
+        return best;
+    }
+    
+    std::vector<int> boxCells;
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            int cell = context->cellOf(x, y);
+            if (cell >= 0 && isBoxTile(level.currentMap[y][x])) {
+                boxCells.push_back(cell);
+            }
+        }
+    }
+    
+    auto boardIndex = [&](int cell) {
+        return context->cellPos[cell].y * level.width + context->cellPos[cell].x;
+    };
+    std::vector<int> boxes;
+    for (const Symmetry& image : context->symmetries) {
+        boxes.clear();
+        for (int cell : boxCells) {
+            boxes.push_back(boardIndex(image.cells[cell]));
+        }
+        std::sort(boxes.begin(), boxes.end());
+        uint64_t hash = positionHash(boxes, boardIndex(image.cells[context->cellOf(playerX, playerY)]));
+        if (hash < best) {
+            best = hash;
+            std::copy(image.dirs, image.dirs + 4, dirs);
+        }
+    }
+    return best;
+}
+
+}
+
+uint64_t levelLayoutHash(const Level& level, int playerX, int playerY) {
+    std::vector<char> playable = playableTiles(level, playerX, playerY);
+    uint64_t hash = mixHash(mixHash(HASH_SEED, level.width), level.height);
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            if (playable[y * level.width + x]) {
+                hash = mixHash(hash, (uint64_t)(y * level.width + x) << 1 | isTargetTile(level.originalMap[y][x]));
+            }
+        }
+    }
+    return hash;
+}
+
+uint64_t levelPositionHash(const Level& level, int playerX, int playerY) {
+    std::vector<char> playable = playableTiles(level, playerX, playerY);
+    std::vector<int> boxes;
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            if (playable[y * level.width + x] && isBoxTile(level.currentMap[y][x])) {
+                boxes.push_back(y * level.width + x);
+            }
+        }
+    }
+    return positionHash(boxes, playerY * level.width + playerX);
+}
+
+bool SolutionCache::load(const char* filename, const std::vector<std::string>& levelFiles) {
+    entries.clear();
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::unordered_set<uint64_t> layouts;
+    for (const std::string& path : levelFiles) {
+        Level level;
+        if (loadLevelFromFile(path.c_str(), &level)) {
+            layouts.insert(levelLayoutHash(level, level.playerStartX, level.playerStartY));
+        }
+    }
+    
+    size_t dropped = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        uint64_t layout, position;
+        std::string moves;
+        
+        if (ss >> std::hex >> layout >> position >> moves) {
+            if (layouts.count(layout)) {
+                entries[layout][position] = moves;
+            } else {
+                dropped++;
+            }
+        }
+    }
+    
+    if (dropped > 0) {
+        std::cout << "Solution cache: dropped " << dropped << " entries for changed or removed levels" << std::endl;
+    }
+    return true;
+}
+
+bool SolutionCache::save(const char* filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << std::hex;
+    for (const auto& layout : entries) {
+        for (const auto& position : layout.second) {
+            file << layout.first << " " << position.first << " " << position.second << std::endl;
+        }
+    }
+    
+    return true;
+}
+
+bool SolutionCache::lookup(const Level& level, int playerX, int playerY, std::vector<char>& solution) const {
+    auto layout = entries.find(levelLayoutHash(level, playerX, playerY));
+    if (layout == entries.end()) {
+        return false;
+    }
+    int dirs[4];
+    auto position = layout->second.find(canonicalPositionHash(level, playerX, playerY, dirs));
+    if (position == layout->second.end()) {
+        return false;
+    }
+    
+    int inverse[4];
+    for (int dir = 0; dir < 4; dir++) {
+        inverse[dirs[dir]] = dir;
+    }
+    std::string moves = mapMoves(position->second, inverse);
+    int pushes;
+    if (!replaySolution(level, playerX, playerY, moves, pushes)) {
+        return false;
+    }
+    
+    solution.assign(moves.begin(), moves.end());
+    return true;
+}
+
+void SolutionCache::store(const Level& level, int playerX, int playerY, const std::vector<char>& solution) {
+    if (solution.empty()) {
+        return;
+    }
+    int dirs[4];
+    uint64_t position = canonicalPositionHash(level, playerX, playerY, dirs);
+    std::string moves(solution.begin(), solution.end());
+    entries[levelLayoutHash(level, playerX, playerY)][position] = mapMoves(moves, dirs);
+}
+
+size_t SolutionCache::size() const {
+    size_t total = 0;
+    for (const auto& layout : entries) {
+        total += layout.second.size();
+    }
+    return total;
+}
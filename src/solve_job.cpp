@@ -0,0 +1,134 @@
+#include "include/solve_job.h"
+#include <climits>
+
+SolveJob solveJob;
+
+SolveJob::SolveJob() {}
+
+SolveJob::~SolveJob() {
+    stop();
+}
+
+bool SolveJob::start(const Level& level, int playerX, int playerY) {
+    reap();
+    if (active()) {
+        // A cancelled job may take a while to notice, so it finishes on its
+        // own; its result is dropped, but not the patterns it learned.
+        if (!current->done && !current->control.cancelled()) {
+            return false;
+        }
+        if (retiring) {
+            return false;
+        }
+        retiring = std::move(current);
+        reap();
+    }
+    
+    // The level tables and stored patterns are looked up here: the caches
+    // behind them are only ever touched from the main thread.
+    current.reset(new SolveRun());
+    current->prepared = prepareLevelContext(level);
+    if (current->prepared) {
+        deadlockPatternStore.fill(level, playerX, playerY, *current->prepared, current->patterns);
+    }
+    copyLevel(level, &current->snapshot);
+    current->startX = playerX;
+    current->startY = playerY;
+    current->startTime = std::chrono::steady_clock::now();
+    current->worker = std::thread(&SolveJob::run, current.get());
+    return true;
+}
+
+void SolveJob::run(SolveRun* job) {
+    job->result = solveWithAdvancedSolver(job->snapshot, job->startX, job->startY, job->prepared.get(), &job->control,
+                                          job->prepared ? &job->patterns : nullptr, job->resultStats);
+    job->done.store(true, std::memory_order_release);
+}
+
+void SolveJob::cancel() {
+    if (current) {
+        current->control.cancel = true;
+    }
+}
+
+void SolveJob::stop() {
+    for (SolveRun* job : {current.get(), retiring.get()}) {
+        if (job && job->worker.joinable()) {
+            job->control.cancel = true;
+            job->worker.join();
+        }
+    }
+    current.reset();
+    retiring.reset();
+}
+
+int SolveJob::reap() {
+    if (!retiring || !retiring->done.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    retiring->worker.join();
+    int learned = 0;
+    if (retiring->prepared) {
+        learned = deadlockPatternStore.merge(retiring->snapshot, retiring->startX, retiring->startY, *retiring->prepared,
+                                             retiring->patterns);
+    }
+    retiring.reset();
+    return learned;
+}
+
+bool SolveJob::matches(const Level& level) const {
+    if (!current) {
+        return false;
+    }
+    const Level& snapshot = current->snapshot;
+    if (level.width != snapshot.width || level.height != snapshot.height) {
+        return false;
+    }
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            if (level.currentMap[y][x] != snapshot.currentMap[y][x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+SolveProgress SolveJob::progress() const {
+    SolveProgress progress;
+    if (!current) {
+        progress.running = false;
+        progress.nodes = 0;
+        progress.frontier = 0;
+        progress.bestH = INT_MAX;
+        progress.elapsedMs = 0;
+        progress.nodesPerSecond = 0;
+        return progress;
+    }
+    
+    const SolverControl& control = current->control;
+    progress.running = current->worker.joinable() && !current->done.load(std::memory_order_acquire);
+    progress.nodes = control.nodes.load(std::memory_order_relaxed);
+    progress.frontier = control.frontier.load(std::memory_order_relaxed);
+    progress.bestH = control.bestH.load(std::memory_order_relaxed);
+    
+    auto elapsed = std::chrono::steady_clock::now() - current->startTime;
+    progress.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    progress.nodesPerSecond = progress.elapsedMs > 0 ? progress.nodes * 1000 / progress.elapsedMs : 0;
+    return progress;
+}
+
+bool SolveJob::collect(std::vector<char>& solution, SolveStats& stats) {
+    if (!active() || !current->done.load(std::memory_order_acquire)) {
+        return false;
+    }
+    current->worker.join();
+    solution.swap(current->result);
+    stats = current->resultStats;
+    if (current->prepared) {
+        stats.patternsLearned = deadlockPatternStore.merge(current->snapshot, current->startX, current->startY,
+                                                           *current->prepared, current->patterns);
+    }
+    current->prepared.reset();
+    return true;
+}
@@ -1,24 +1,193 @@
 #include "include/solver.h"
 #include "include/advanced_solver.h"
+#include "include/ida_solver.h"
+#include "include/parallel_solver.h"
+#include "include/bidirectional_solver.h"
+#include "include/external_solver.h"
+#include "include/portfolio_solver.h"
+#include "include/solution_optimizer.h"
+#include "include/board_solver.h"
 #include <iostream>
 #include <chrono>
 
 int solverNodesExplored = 0;
 int solverMaxQueueSize = 0;
 int solverExecutionTimeMs = 0;
+int solverThreadCount = 0;
+bool solverMacroMoves = true;
+bool solverPortfolioImprove = false;
+SolverEngine solverEngine = SOLVER_ENGINE_PORTFOLIO;
 
-std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize) {
+std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, const SolverContext* prepared,
+                                          SolverControl* control, DeadlockPatterns* patterns, SolveStats& stats) {
     auto startTime = std::chrono::high_resolution_clock::now();
     
-    AdvancedSolver solver;
-    std::string solution = solver.solve(level, playerX, playerY);
+    int& nodesExplored = stats.nodesExplored;
+    int& maxQueueSize = stats.maxQueueSize;
+    std::string solution;
+    bool limitReached = false;
+    bool cancelled = false;
+    // Whether the solution has the fewest pushes; the optimizer keeps them.
+    bool pushOptimal = true;
+    size_t arenaUsed = 0;
+    size_t arenaReserved = 0;
+    
+    // The engines all need a SolverContext, which cannot index this much
+    // floor; the board-indexed search takes the level instead.
+    if (!prepared && countFloorCells(level, playerX, playerY) > MAX_FLOOR_CELLS) {
+        BoardSolver solver;
+        solver.setControl(control);
+        solution = solver.solve(level, playerX, playerY);
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxQueueSize();
+        cancelled = solver.isCancelled();
+        std::cout << "Board solver - Level has more than " << MAX_FLOOR_CELLS << " floor cells, Peak memory: "
+                  << solver.getPeakBytes() / 1024 << " KB" << std::endl;
+        if (solver.isTimedOut()) {
+            std::cout << "Solver time limit reached" << std::endl;
+        }
+    } else if (solverEngine == SOLVER_ENGINE_BIDIRECTIONAL) {
+        BidirectionalSolver solver;
+        if (prepared) {
+            solver.setContext(*prepared);
+        }
+        solver.setControl(control);
+        solver.setPatterns(patterns);
+        solution = solver.solve(level, playerX, playerY);
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxQueueSize();
+        limitReached = solver.isLimitReached();
+        cancelled = solver.isCancelled();
+        pushOptimal = false;
+        std::cout << "Bidirectional solver - Forward nodes: " << solver.getForwardNodes()
+                  << ", Backward nodes: " << solver.getBackwardNodes() << std::endl;
+        if (solver.isTimedOut()) {
+            std::cout << "Solver time limit reached" << std::endl;
+        }
+    } else if (solverEngine == SOLVER_ENGINE_EXTERNAL) {
+        ExternalSolver solver;
+        if (prepared) {
+            solver.setContext(*prepared);
+        }
+        solver.setControl(control);
+        solver.setPatterns(patterns);
+        solution = solver.solve(level, playerX, playerY);
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxLayerSize();
+        cancelled = solver.wasCancelled();
+        std::cout << "External solver - Layers: " << solver.getLayers()
+                  << ", Written: " << solver.getBytesWritten() / 1024
+                  << " KB, Peak on disk: " << solver.getPeakDiskBytes() / 1024 << " KB" << std::endl;
+    } else if (solverEngine == SOLVER_ENGINE_PORTFOLIO) {
+        // IDA* is one of the racers, so there is nothing to fall back on.
+        PortfolioSolver solver;
+        if (prepared) {
+            solver.setContext(*prepared);
+        }
+        solver.setControl(control);
+        solver.setPatterns(patterns);
+        solver.setImprove(solverPortfolioImprove);
+        solution = solver.solve(level, playerX, playerY);
+        stats.patternsLearned = solver.getPatternsLearned();
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxQueueSize();
+        cancelled = solver.isCancelled();
+        pushOptimal = solver.isWinnerPushOptimal();
+        std::cout << "Portfolio solver - Racers: " << solver.getRacerCount()
+                  << ", Winner: " << (solver.getWinner() ? solver.getWinner() : "none")
+                  << ", First solution: " << solver.getFirstSolutionMs() << "ms" << std::endl;
+        if (solver.isTimedOut()) {
+            std::cout << "Solver time limit reached" << std::endl;
+        }
+    } else if (solverEngine == SOLVER_ENGINE_PARALLEL) {
+        ParallelSolver solver(solverThreadCount);
+        if (prepared) {
+            solver.setContext(*prepared);
+        }
+        solver.setControl(control);
+        solver.setPatterns(patterns);
+        solution = solver.solve(level, playerX, playerY);
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxQueueSize();
+        limitReached = solver.isLimitReached();
+        cancelled = solver.isCancelled();
+        std::cout << "Parallel solver - Threads: " << solver.getThreadCount()
+                  << ", States sent between threads: " << solver.getStatesSent() << std::endl;
+        if (solver.isTimedOut()) {
+            std::cout << "Solver time limit reached" << std::endl;
+        }
+    } else {
+        AdvancedSolver solver;
+        if (prepared) {
+            solver.setContext(*prepared);
+        }
+        solver.setControl(control);
+        solver.setPatterns(patterns);
+        solver.setMacroMoves(solverMacroMoves);
+        solution = solver.solve(level, playerX, playerY);
+        pushOptimal = !solverMacroMoves;
+        stats.patternsLearned = solver.getPatternsLearned();
+        if (patterns) {
+            std::cout << "Deadlock patterns - Known: " << patterns->size() << ", Learned: " << solver.getPatternsLearned()
+                      << ", Pushes pruned: " << solver.getPatternPrunes() << std::endl;
+        }
+        if (solverMacroMoves) {
+            std::cout << "Macro moves - Tunnel and goal room pushes taken as one: " << solver.getMacroChildren()
+                      << std::endl;
+        }
+        nodesExplored = solver.getNodesExplored();
+        maxQueueSize = solver.getMaxQueueSize();
+        limitReached = solver.isLimitReached();
+        cancelled = solver.isCancelled();
+        arenaUsed = solver.getArenaBytesUsed();
+        arenaReserved = solver.getArenaBytesReserved();
+        if (solver.isTimedOut()) {
+            std::cout << "Solver time limit reached" << std::endl;
+        }
+    }
+    
+    // The best-first searches keep every state they have seen; once they run
+    // out of memory or nodes, carry on with IDA*, whose memory only grows
+    // with the solution depth.
+    if (solution.empty() && limitReached && !cancelled) {
+        std::cout << "Search limit reached, continuing with IDA*" << std::endl;
+        IdaSolver idaSolver;
+        if (prepared) {
+            idaSolver.setContext(*prepared);
+        }
+        idaSolver.setControl(control);
+        idaSolver.setPatterns(patterns);
+        solution = idaSolver.solve(level, playerX, playerY);
+        pushOptimal = true;
+        nodesExplored += idaSolver.getNodesExplored();
+        cancelled = idaSolver.wasCancelled();
+        std::cout << "IDA* stats - Nodes explored: " << idaSolver.getNodesExplored()
+                  << ", Iterations: " << idaSolver.getIterations()
+                  << ", Time: " << idaSolver.getExecutionTimeMs() << "ms" << std::endl;
+    }
+    
+    if (!solution.empty() && !cancelled) {
+        SolverContext built;
+        const SolverContext* context = prepared;
+        if (!context && built.build(level, playerX, playerY)) {
+            context = &built;
+        }
+        if (context) {
+            SolutionOptimizer optimizer;
+            optimizer.setControl(control);
+            optimizer.setObjective(pushOptimal ? OPTIMIZE_PUSHES : OPTIMIZE_MOVES);
+            solution = optimizer.optimize(*context, level, playerX, playerY, solution);
+            std::cout << "Optimizer (" << optimizer.getObjectiveName() << ") - Moves: " << optimizer.getMovesBefore()
+                      << " -> " << optimizer.getMovesAfter() << ", Pushes: " << optimizer.getPushesBefore() << " -> " << optimizer.getPushesAfter()
+                      << ", Windows improved: " << optimizer.getWindowsImproved() << std::endl;
+        }
+    }
     
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
     
-    nodesExplored = solver.getNodesExplored();
-    maxQueueSize = solver.getMaxQueueSize();
-    solverExecutionTimeMs = duration.count();
+    stats.executionTimeMs = duration.count();
+    stats.cancelled = cancelled;
     
     std::vector<char> solutionMoves;
     for (char c : solution) {
@@ -27,14 +196,37 @@ std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY
     
     std::cout << "Solver stats - Nodes explored: " << nodesExplored 
               << ", Max queue size: " << maxQueueSize 
-              << ", Time: " << solverExecutionTimeMs << "ms" << std::endl;
+              << ", Time: " << stats.executionTimeMs << "ms"
+              << ", Arena: " << arenaUsed / 1024 << "/"
+              << arenaReserved / 1024 << " KB used/reserved" << std::endl;
+    if (cancelled) {
+        std::cout << "Solver cancelled" << std::endl;
+    }
     std::cout << "Solution length: " << solutionMoves.size() << std::endl;
     
     return solutionMoves;
 }
 
 std::vector<char> solveSokoban(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize) {
-    return solveWithAdvancedSolver(level, playerX, playerY, nodesExplored, maxQueueSize);
+    SolveStats stats;
+    std::shared_ptr<const SolverContext> prepared = prepareLevelContext(level);
+    DeadlockPatterns patterns;
+    if (prepared) {
+        deadlockPatternStore.fill(level, playerX, playerY, *prepared, patterns);
+    }
+    std::vector<char> solution = solveWithAdvancedSolver(level, playerX, playerY, prepared.get(), nullptr,
+                                                         prepared ? &patterns : nullptr, stats);
+    if (prepared && deadlockPatternStore.merge(level, playerX, playerY, *prepared, patterns) > 0) {
+        deadlockPatternStore.save(DEADLOCK_PATTERN_FILE);
+    }
+    nodesExplored = stats.nodesExplored;
+    maxQueueSize = stats.maxQueueSize;
+    solverExecutionTimeMs = stats.executionTimeMs;
+    return solution;
+}
+
+std::vector<char> solveWithAdvancedSolver(Level& level, int playerX, int playerY, int& nodesExplored, int& maxQueueSize) {
+    return solveSokoban(level, playerX, playerY, nodesExplored, maxQueueSize);
 }
 
 bool solveLevel(Level& level, std::vector<char>& solution, int& nodesExplored, int& maxQueueSize) {
@@ -0,0 +1,769 @@
+#include "include/solver_context.h"
+#include <random>
+#include <algorithm>
+
+static const int dirDx[4] = {0, 1, 0, -1};
+static const int dirDy[4] = {-1, 0, 1, 0};
+
+const uint16_t SolverContext::UNREACHABLE;
+
+void ZobristTable::init(int cellCount) {
+    std::mt19937_64 rng(0x5eed50c0ba11ULL);
+    for (auto* keys : {&boxKeys, &playerKeys, &boxCheckKeys, &playerCheckKeys}) {
+        keys->resize(cellCount);
+        for (uint64_t& key : *keys) {
+            key = rng();
+        }
+    }
+}
+
+// Marks the board cells the player can walk to from its cell, ignoring
+// boxes. False if the player stands off the board or on a wall.
+static bool floodFloor(const Level& level, int playerX, int playerY, std::vector<bool>& floor) {
+    int width = level.width;
+    int height = level.height;
+    floor.assign(width * height, false);
+    if (playerX < 0 || playerY < 0 || playerX >= width || playerY >= height ||
+        level.originalMap[playerY][playerX] == WALL) {
+        return false;
+    }
+    
+    std::vector<Position> stack;
+    stack.push_back(Position(playerX, playerY));
+    floor[playerY * width + playerX] = true;
+    
+    while (!stack.empty()) {
+        Position pos = stack.back();
+        stack.pop_back();
+        
+        for (int dir = 0; dir < 4; dir++) {
+            int nx = pos.x + dirDx[dir];
+            int ny = pos.y + dirDy[dir];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+            if (level.originalMap[ny][nx] == WALL || floor[ny * width + nx]) continue;
+            floor[ny * width + nx] = true;
+            stack.push_back(Position(nx, ny));
+        }
+    }
+    return true;
+}
+
+int countFloorCells(const Level& level, int playerX, int playerY) {
+    std::vector<bool> floor;
+    if (!floodFloor(level, playerX, playerY, floor)) {
+        return 0;
+    }
+    return std::count(floor.begin(), floor.end(), true);
+}
+
+bool SolverContext::build(const Level& level, int playerX, int playerY) {
+    width = level.width;
+    height = level.height;
+    floorCount = 0;
+    cellAt.assign(width * height, -1);
+    cellPos.clear();
+    neighbours.clear();
+    targets.clear();
+    targetCells.clear();
+    
+    std::vector<bool> floor;
+    if (!floodFloor(level, playerX, playerY, floor)) {
+        return false;
+    }
+    
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (!floor[y * width + x]) continue;
+            if (floorCount >= MAX_FLOOR_CELLS) {
+                return false;
+            }
+            cellAt[y * width + x] = floorCount++;
+            cellPos.push_back(Position(x, y));
+        }
+    }
+    
+    neighbours.resize(floorCount * 4);
+    for (int cell = 0; cell < floorCount; cell++) {
+        const Position& pos = cellPos[cell];
+        for (int dir = 0; dir < 4; dir++) {
+            neighbours[cell * 4 + dir] = cellOf(pos.x + dirDx[dir], pos.y + dirDy[dir]);
+        }
+        
+        TileType tile = level.originalMap[pos.y][pos.x];
+        if (tile == TARGET || tile == BOX_ON_TARGET) {
+            targets.set(cell);
+            targetCells.push_back(cell);
+        }
+    }
+    
+    computeDeadSquares();
+    computeSideGroups();
+    computePushDistances();
+    computeTunnels();
+    computeGoalRooms();
+    computeSymmetries();
+    zobrist.init(floorCount);
+    return true;
+}
+
+// Pulls a box backwards from every target: a pull moves the box from `cell`
+// to its neighbour and needs the cell beyond that free for the player. Every
+// cell never reached this way is dead, whatever the other boxes do.
+void SolverContext::computeDeadSquares() {
+    BoxSet live;
+    std::vector<int> queue(targetCells.begin(), targetCells.end());
+    for (int target : targetCells) {
+        live.set(target);
+    }
+    
+    for (size_t head = 0; head < queue.size(); head++) {
+        int cell = queue[head];
+        for (int dir = 0; dir < 4; dir++) {
+            int boxTo = neighbour(cell, dir);
+            if (boxTo < 0 || live.test(boxTo)) continue;
+            if (neighbour(boxTo, dir) < 0) continue;
+            live.set(boxTo);
+            queue.push_back(boxTo);
+        }
+    }
+    
+    deadSquares.clear();
+    for (int cell = 0; cell < floorCount; cell++) {
+        if (!live.test(cell)) {
+            deadSquares.set(cell);
+        }
+    }
+}
+
+bool SolverContext::packState(const Level& level, int playerX, int playerY, PackedState& state) const {
+    state.boxes.clear();
+    int playerCell = cellOf(playerX, playerY);
+    if (playerCell < 0) {
+        return false;
+    }
+    state.player = playerCell;
+    
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            TileType tile = level.currentMap[y][x];
+            if (tile != BOX && tile != BOX_ON_TARGET) continue;
+            
+            int cell = cellOf(x, y);
+            if (cell < 0) {
+                return false;
+            }
+            state.boxes.set(cell);
+        }
+    }
+    
+    return !state.boxes.test(state.player);
+}
+
+// For a box on each cell, labels its four sides so that two sides share a
+// group exactly when the player can walk from one to the other around the
+// box, other boxes ignored.
+void SolverContext::computeSideGroups() {
+    sideGroups.assign(floorCount * 4, 0xFF);
+    std::vector<int> seen(floorCount, -1);
+    std::vector<int> stack;
+    
+    for (int box = 0; box < floorCount; box++) {
+        for (int side = 0; side < 4; side++) {
+            int start = neighbour(box, side);
+            if (start < 0 || sideGroups[box * 4 + side] != 0xFF) continue;
+            
+            int fill = box * 4 + side;
+            seen[start] = fill;
+            stack.assign(1, start);
+            while (!stack.empty()) {
+                int cell = stack.back();
+                stack.pop_back();
+                for (int dir = 0; dir < 4; dir++) {
+                    int next = neighbour(cell, dir);
+                    if (next < 0 || next == box || seen[next] == fill) continue;
+                    seen[next] = fill;
+                    stack.push_back(next);
+                }
+            }
+            
+            for (int other = side; other < 4; other++) {
+                int cell = neighbour(box, other);
+                if (cell >= 0 && seen[cell] == fill) {
+                    sideGroups[box * 4 + other] = side;
+                }
+            }
+        }
+    }
+}
+
+void SolverContext::computePushDistances() {
+    computePushDistancesTo(targetCells, pushDistances);
+}
+
+// Reverse BFS from each goal over (box cell, player side) pairs. A pull
+// moves the box one step towards the player, who steps back one further;
+// between pulls the player may walk to any side in the same side group.
+void SolverContext::computePushDistancesTo(const std::vector<int>& goals, std::vector<uint16_t>& table) const {
+    table.assign(goals.size() * floorCount, UNREACHABLE);
+    std::vector<uint16_t> distance(floorCount * 4);
+    std::vector<int> queue;
+    
+    for (size_t t = 0; t < goals.size(); t++) {
+        std::fill(distance.begin(), distance.end(), UNREACHABLE);
+        queue.clear();
+        
+        int target = goals[t];
+        for (int side = 0; side < 4; side++) {
+            if (neighbour(target, side) >= 0) {
+                distance[target * 4 + side] = 0;
+                queue.push_back(target * 4 + side);
+            }
+        }
+        
+        for (size_t head = 0; head < queue.size(); head++) {
+            int box = queue[head] / 4;
+            int side = queue[head] % 4;
+            uint16_t next = distance[queue[head]] + 1;
+            
+            int boxTo = neighbour(box, side);
+            int playerTo = boxTo >= 0 ? neighbour(boxTo, side) : -1;
+            if (playerTo < 0 || distance[boxTo * 4 + side] != UNREACHABLE) continue;
+            
+            uint8_t group = sideGroups[boxTo * 4 + side];
+            for (int other = 0; other < 4; other++) {
+                if (sideGroups[boxTo * 4 + other] == group && distance[boxTo * 4 + other] == UNREACHABLE) {
+                    distance[boxTo * 4 + other] = next;
+                    queue.push_back(boxTo * 4 + other);
+                }
+            }
+        }
+        
+        for (int cell = 0; cell < floorCount; cell++) {
+            uint16_t best = UNREACHABLE;
+            for (int side = 0; side < 4; side++) {
+                best = std::min(best, distance[cell * 4 + side]);
+            }
+            table[t * floorCount + cell] = best;
+        }
+    }
+}
+
+// Forward BFS over (box cell, player side) pairs from each source. Pushing
+// away from the player's side leaves the player on that same side of the
+// box's new cell.
+void SolverContext::computePushDistancesFrom(const std::vector<int>& sources, std::vector<uint16_t>& table) const {
+    table.assign(sources.size() * floorCount, UNREACHABLE);
+    std::vector<uint16_t> distance(floorCount * 4);
+    std::vector<int> queue;
+    
+    for (size_t s = 0; s < sources.size(); s++) {
+        std::fill(distance.begin(), distance.end(), UNREACHABLE);
+        queue.clear();
+        
+        int source = sources[s];
+        for (int side = 0; side < 4; side++) {
+            if (neighbour(source, side) >= 0) {
+                distance[source * 4 + side] = 0;
+                queue.push_back(source * 4 + side);
+            }
+        }
+        
+        for (size_t head = 0; head < queue.size(); head++) {
+            int box = queue[head] / 4;
+            int side = queue[head] % 4;
+            uint16_t next = distance[queue[head]] + 1;
+            
+            int boxTo = neighbour(box, (side + 2) % 4);
+            if (boxTo < 0 || distance[boxTo * 4 + side] != UNREACHABLE) continue;
+            
+            uint8_t group = sideGroups[boxTo * 4 + side];
+            for (int other = 0; other < 4; other++) {
+                if (sideGroups[boxTo * 4 + other] == group && distance[boxTo * 4 + other] == UNREACHABLE) {
+                    distance[boxTo * 4 + other] = next;
+                    queue.push_back(boxTo * 4 + other);
+                }
+            }
+        }
+        
+        for (int cell = 0; cell < floorCount; cell++) {
+            uint16_t best = UNREACHABLE;
+            for (int side = 0; side < 4; side++) {
+                best = std::min(best, distance[cell * 4 + side]);
+            }
+            table[s * floorCount + cell] = best;
+        }
+    }
+}
+
+// A cell is a tunnel for pushes in `dir` when walls flank both it and the
+// cell behind it across that direction: a box pushed onto it can only go
+// on or come back, and the player can only follow it. Targets are left out,
+// since a box may have to stop on one.
+void SolverContext::computeTunnels() {
+    for (int dir = 0; dir < 4; dir++) {
+        tunnels[dir].clear();
+        for (int cell = 0; cell < floorCount; cell++) {
+            int behind = neighbour(cell, (dir + 2) % 4);
+            if (behind < 0 || isTarget(cell)) continue;
+            
+            bool walled = true;
+            for (int side : {(dir + 1) % 4, (dir + 3) % 4}) {
+                walled = walled && neighbour(cell, side) < 0 && neighbour(behind, side) < 0;
+            }
+            if (walled) {
+                tunnels[dir].set(cell);
+            }
+        }
+    }
+}
+
+// A goal room hangs off a bridge of the floor, a step from `outside` to
+// `entrance` that is the only way between the two sides. Nested dead ends
+// along a corridor all qualify, so only the smallest of overlapping ones is
+// kept. The fill order is found backwards: the target a box reaches in the
+// fewest pushes while all others are filled is filled last, and so on.
+void SolverContext::computeGoalRooms() {
+    goalRooms.clear();
+    roomEntries.assign(floorCount * 4, -1);
+    
+    std::vector<GoalRoom> candidates;
+    std::vector<int> stack;
+    for (int outside = 0; outside < floorCount; outside++) {
+        for (int dir = 0; dir < 4; dir++) {
+            int entrance = neighbour(outside, dir);
+            if (entrance < 0 || neighbour(outside, (dir + 2) % 4) < 0) continue;
+            
+            GoalRoom room;
+            room.outside = outside;
+            room.entrance = entrance;
+            room.dir = dir;
+            room.cells.set(entrance);
+            stack.assign(1, entrance);
+            int size = 1;
+            bool bridge = true;
+            
+            while (!stack.empty() && bridge && size <= MAX_GOAL_ROOM_CELLS) {
+                int cell = stack.back();
+                stack.pop_back();
+                for (int side = 0; side < 4; side++) {
+                    int next = neighbour(cell, side);
+                    if (next < 0 || room.cells.test(next)) continue;
+                    if (next == outside) {
+                        bridge = bridge && cell == entrance;
+                        continue;
+                    }
+                    room.cells.set(next);
+                    stack.push_back(next);
+                    size++;
+                }
+            }
+            
+            bool hasTarget = false;
+            for (int target : targetCells) {
+                hasTarget = hasTarget || room.cells.test(target);
+            }
+            if (bridge && size <= MAX_GOAL_ROOM_CELLS && hasTarget) {
+                candidates.push_back(room);
+            }
+        }
+    }
+    
+    std::stable_sort(candidates.begin(), candidates.end(), [](const GoalRoom& a, const GoalRoom& b) {
+        return a.cells.count() < b.cells.count();
+    });
+    
+    std::vector<PushMove> path;
+    for (GoalRoom& room : candidates) {
+        bool overlaps = false;
+        for (const GoalRoom& kept : goalRooms) {
+            for (int i = 0; i < BOX_SET_WORDS; i++) {
+                overlaps = overlaps || (room.cells.words[i] & kept.cells.words[i]) != 0;
+            }
+        }
+        if (overlaps) continue;
+        
+        BoxSet remaining;
+        for (int target : targetCells) {
+            if (room.cells.test(target)) {
+                remaining.set(target);
+            }
+        }
+        
+        while (remaining.count() > 0) {
+            int best = -1;
+            std::vector<PushMove> bestPath;
+            for (int target = remaining.next(0); target >= 0; target = remaining.next(target + 1)) {
+                BoxSet obstacles = remaining;
+                obstacles.reset(target);
+                if (findRoomPath(room, obstacles, target, path) && (best < 0 || path.size() < bestPath.size())) {
+                    best = target;
+                    bestPath = path;
+                }
+            }
+            if (best < 0) break;
+            
+            room.order.push_back(best);
+            room.paths.push_back(bestPath);
+            remaining.reset(best);
+        }
+        if (remaining.count() > 0) continue;
+        
+        std::reverse(room.order.begin(), room.order.end());
+        std::reverse(room.paths.begin(), room.paths.end());
+        room.filled.assign(1, BoxSet());
+        for (int target : room.order) {
+            room.filled.push_back(room.filled.back());
+            room.filled.back().set(target);
+        }
+        
+        roomEntries[room.outside * 4 + room.dir] = goalRooms.size();
+        goalRooms.push_back(room);
+    }
+}
+
+// Fewest pushes that take a box from the room's entrance, with the player
+// just outside, onto `target` while `obstacles` stand in the room. The
+// player never needs the floor beyond `outside`: the way back in would
+// lead through it anyway.
+bool SolverContext::findRoomPath(const GoalRoom& room, const BoxSet& obstacles, int target,
+                                 std::vector<PushMove>& path) const {
+    path.clear();
+    if (obstacles.test(room.entrance)) {
+        return false;
+    }
+    if (room.entrance == target) {
+        return true;
+    }
+    
+    BoxSet walkable = room.cells;
+    walkable.set(room.outside);
+    std::vector<int> stack;
+    auto flood = [&](int box, int player, std::vector<char>& region) {
+        region.assign(floorCount, 0);
+        region[player] = 1;
+        stack.assign(1, player);
+        int lowest = player;
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            lowest = std::min(lowest, cell);
+            for (int dir = 0; dir < 4; dir++) {
+                int next = neighbour(cell, dir);
+                if (next >= 0 && !region[next] && next != box && walkable.test(next) && !obstacles.test(next)) {
+                    region[next] = 1;
+                    stack.push_back(next);
+                }
+            }
+        }
+        return lowest;
+    };
+    
+    // States are box cell * floorCount + the player's lowest reachable cell.
+    std::vector<int> cameFrom(floorCount * floorCount, -1);
+    std::vector<char> pushDir(floorCount * floorCount, 0);
+    std::vector<char> region, childRegion;
+    int start = room.entrance * floorCount + flood(room.entrance, room.outside, region);
+    std::vector<int> queue(1, start);
+    cameFrom[start] = start;
+    
+    for (size_t head = 0; head < queue.size(); head++) {
+        int box = queue[head] / floorCount;
+        flood(box, queue[head] % floorCount, region);
+        
+        for (int dir = 0; dir < 4; dir++) {
+            int from = neighbour(box, (dir + 2) % 4);
+            int to = neighbour(box, dir);
+            if (from < 0 || !region[from] || to < 0 || !room.cells.test(to) || obstacles.test(to)) continue;
+            
+            int state = to * floorCount + flood(to, box, childRegion);
+            if (cameFrom[state] >= 0) continue;
+            cameFrom[state] = queue[head];
+            pushDir[state] = dir;
+            
+            if (to == target) {
+                for (int at = state; at != start; at = cameFrom[at]) {
+                    path.push_back(PushMove(cameFrom[at] / floorCount, pushDir[at]));
+                }
+                std::reverse(path.begin(), path.end());
+                return true;
+            }
+            queue.push_back(state);
+        }
+    }
+    
+    return false;
+}
+
+// How many of the room's targets are filled, or -1 if its boxes are not
+// exactly the first ones of its order.
+int SolverContext::roomProgress(const GoalRoom& room, const BoxSet& boxes) const {
+    BoxSet inRoom;
+    for (int i = 0; i < BOX_SET_WORDS; i++) {
+        inRoom.words[i] = boxes.words[i] & room.cells.words[i];
+    }
+    int filled = inRoom.count();
+    return filled <= (int)room.order.size() && inRoom == room.filled[filled] ? filled : -1;
+}
+
+void SolverContext::expandPush(const BoxSet& boxes, const PushMove& push, std::vector<PushMove>& pushes) const {
+    pushes.assign(1, push);
+    while (true) {
+        PushMove last = pushes.back();
+        int room = roomEntries[last.box * 4 + last.dir];
+        if (room >= 0) {
+            const GoalRoom& entered = goalRooms[room];
+            int filled = roomProgress(entered, boxes);
+            if (filled >= 0 && filled < (int)entered.order.size()) {
+                pushes.insert(pushes.end(), entered.paths[filled].begin(), entered.paths[filled].end());
+            }
+            return;
+        }
+        
+        int box = neighbour(last.box, last.dir);
+        int next = neighbour(box, last.dir);
+        if (!tunnels[last.dir].test(box) || next < 0 || boxes.test(next) || isDead(next)) {
+            return;
+        }
+        pushes.push_back(PushMove(box, last.dir));
+    }
+}
+
+void SolverContext::packedRoomBoxes(const BoxSet& boxes, BoxSet& packed) const {
+    packed.clear();
+    for (const GoalRoom& room : goalRooms) {
+        int filled = roomProgress(room, boxes);
+        if (filled > 0) {
+            for (int i = 0; i < BOX_SET_WORDS; i++) {
+                packed.words[i] |= room.filled[filled].words[i];
+            }
+        }
+    }
+}
+
+// Tries the seven non-trivial reflections and rotations of the floor's
+// bounding box; the four that swap the axes need a square one. Each is a
+// linear map of the offsets in the box, shifted back into it.
+void SolverContext::computeSymmetries() {
+    static const int maps[7][4] = {
+        {-1, 0, 0, 1}, {1, 0, 0, -1}, {-1, 0, 0, -1},
+        {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, -1, 0}, {0, -1, -1, 0}
+    };
+    symmetries.clear();
+    if (floorCount == 0) {
+        return;
+    }
+    
+    int minX = width, minY = height, maxX = 0, maxY = 0;
+    for (const Position& pos : cellPos) {
+        minX = std::min(minX, pos.x);
+        minY = std::min(minY, pos.y);
+        maxX = std::max(maxX, pos.x);
+        maxY = std::max(maxY, pos.y);
+    }
+    int spanX = maxX - minX;
+    int spanY = maxY - minY;
+    
+    for (const int* m : maps) {
+        if (m[1] != 0 && spanX != spanY) continue;
+        
+        Symmetry symmetry;
+        symmetry.cells.resize(floorCount);
+        bool valid = true;
+        for (int cell = 0; cell < floorCount && valid; cell++) {
+            int u = cellPos[cell].x - minX;
+            int v = cellPos[cell].y - minY;
+            int x = minX + m[0] * u + m[1] * v + (m[0] < 0 ? spanX : 0) + (m[1] < 0 ? spanY : 0);
+            int y = minY + m[2] * u + m[3] * v + (m[2] < 0 ? spanX : 0) + (m[3] < 0 ? spanY : 0);
+            int image = cellOf(x, y);
+            valid = image >= 0 && isTarget(image) == isTarget(cell);
+            symmetry.cells[cell] = image;
+        }
+        if (!valid) continue;
+        
+        for (int dir = 0; dir < 4; dir++) {
+            int dx = m[0] * dirDx[dir] + m[1] * dirDy[dir];
+            int dy = m[2] * dirDx[dir] + m[3] * dirDy[dir];
+            for (int image = 0; image < 4; image++) {
+                if (dirDx[image] == dx && dirDy[image] == dy) {
+                    symmetry.dirs[dir] = image;
+                }
+            }
+        }
+        symmetries.push_back(symmetry);
+    }
+}
+
+void SolverContext::canonicalKeys(const PackedState& state, const std::vector<char>* region, uint64_t& hash,
+                                  uint64_t& check) const {
+    for (const Symmetry& symmetry : symmetries) {
+        int player = symmetry.cells[state.player];
+        if (region) {
+            for (int cell = 0; cell < floorCount; cell++) {
+                if ((*region)[cell]) {
+                    player = std::min(player, symmetry.cells[cell]);
+                }
+            }
+        }
+        
+        uint64_t imageHash = zobrist.playerKeys[player];
+        uint64_t imageCheck = zobrist.playerCheckKeys[player];
+        for (int box = state.boxes.next(0); box >= 0; box = state.boxes.next(box + 1)) {
+            imageHash ^= zobrist.boxKeys[symmetry.cells[box]];
+            imageCheck ^= zobrist.boxCheckKeys[symmetry.cells[box]];
+        }
+        if (imageHash < hash) {
+            hash = imageHash;
+            check = imageCheck;
+        }
+    }
+}
+
+// A box is frozen when it is blocked along both axes. Along one axis it is
+// blocked by a wall on either side, by dead squares on both sides, or by a
+// neighbouring box that is itself frozen. Boxes on the current recursion
+// path count as walls, which breaks cycles in box clusters. `offTarget`
+// reports whether any box found frozen is off a target.
+bool SolverContext::isFrozen(const BoxSet& boxes, int cell, BoxSet& onPath, bool& offTarget) const {
+    onPath.set(cell);
+    bool frozen = true;
+    bool clusterOffTarget = !isTarget(cell);
+    
+    for (int axis = 0; axis < 2 && frozen; axis++) {
+        int sideA = neighbour(cell, axis);
+        int sideB = neighbour(cell, axis + 2);
+        
+        if (sideA < 0 || sideB < 0) continue;
+        if (isDead(sideA) && isDead(sideB)) continue;
+        
+        bool blocked = false;
+        for (int side : {sideA, sideB}) {
+            if (!boxes.test(side)) continue;
+            bool sideOffTarget = false;
+            if (onPath.test(side) || isFrozen(boxes, side, onPath, sideOffTarget)) {
+                blocked = true;
+                clusterOffTarget = clusterOffTarget || sideOffTarget;
+                break;
+            }
+        }
+        frozen = blocked;
+    }
+    
+    onPath.reset(cell);
+    if (frozen) {
+        offTarget = clusterOffTarget;
+    }
+    return frozen;
+}
+
+bool SolverContext::isFreezeDeadlock(const BoxSet& boxes, int cell) const {
+    BoxSet onPath;
+    bool offTarget = false;
+    return isFrozen(boxes, cell, onPath, offTarget) && offTarget;
+}
+
+bool SolverContext::findWalk(const BoxSet& boxes, int from, int to, std::string& walk) const {
+    static const char dirChars[4] = {'U', 'R', 'D', 'L'};
+    walk.clear();
+    if (from == to) {
+        return true;
+    }
+    
+    std::vector<int> cameFrom(floorCount, -1);
+    std::vector<int> queue(1, from);
+    cameFrom[from] = 4;
+    
+    for (size_t head = 0; head < queue.size() && cameFrom[to] == -1; head++) {
+        int cell = queue[head];
+        for (int dir = 0; dir < 4; dir++) {
+            int next = neighbour(cell, dir);
+            if (next >= 0 && cameFrom[next] == -1 && !boxes.test(next)) {
+                cameFrom[next] = dir;
+                queue.push_back(next);
+            }
+        }
+    }
+    
+    if (cameFrom[to] == -1) {
+        return false;
+    }
+    
+    for (int cell = to; cell != from; ) {
+        int dir = cameFrom[cell];
+        walk += dirChars[dir];
+        cell = neighbour(cell, (dir + 2) % 4);
+    }
+    std::reverse(walk.begin(), walk.end());
+    return true;
+}
+
+bool replaySolution(const Level& level, int playerX, int playerY, const std::string& moves, int& pushes) {
+    std::vector<std::vector<char>> boxes(level.height, std::vector<char>(level.width, 0));
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            TileType tile = level.currentMap[y][x];
+            boxes[y][x] = tile == BOX || tile == BOX_ON_TARGET;
+        }
+    }
+    
+    auto blocked = [&](int x, int y) {
+        return x < 0 || y < 0 || x >= level.width || y >= level.height || level.originalMap[y][x] == WALL;
+    };
+    
+    int x = playerX;
+    int y = playerY;
+    pushes = 0;
+    for (char move : moves) {
+        int dx = move == 'R' ? 1 : move == 'L' ? -1 : 0;
+        int dy = move == 'D' ? 1 : move == 'U' ? -1 : 0;
+        if ((dx == 0 && dy == 0) || blocked(x + dx, y + dy)) {
+            return false;
+        }
+        x += dx;
+        y += dy;
+        if (boxes[y][x]) {
+            if (blocked(x + dx, y + dy) || boxes[y + dy][x + dx]) {
+                return false;
+            }
+            boxes[y][x] = 0;
+            boxes[y + dy][x + dx] = 1;
+            pushes++;
+        }
+    }
+    
+    for (int by = 0; by < level.height; by++) {
+        for (int bx = 0; bx < level.width; bx++) {
+            TileType tile = level.originalMap[by][bx];
+            if (boxes[by][bx] && tile != TARGET && tile != BOX_ON_TARGET) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const SolverContext> prepareLevelContext(const Level& level) {
+    static std::string cachedKey;
+    static std::shared_ptr<const SolverContext> cached;
+    
+    // Boxes move, so only the static layout goes into the key.
+    std::string key = std::to_string(level.width) + "x" + std::to_string(level.height) + "@" +
+                      std::to_string(level.playerStartX) + "," + std::to_string(level.playerStartY) + ":";
+    for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+            TileType tile = level.originalMap[y][x];
+            key += tile == WALL ? '#' : (tile == TARGET || tile == BOX_ON_TARGET) ? '.' : ' ';
+        }
+    }
+    
+    if (cached && key == cachedKey) {
+        return cached;
+    }
+    
+    std::shared_ptr<SolverContext> context = std::make_shared<SolverContext>();
+    if (!context->build(level, level.playerStartX, level.playerStartY)) {
+        return nullptr;
+    }
+    cachedKey = key;
+    cached = context;
+    return cached;
+}
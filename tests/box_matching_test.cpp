@@ -0,0 +1,106 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+#include "../src/include/box_matching.h"
+
+// Checks BoxMatching on random distance tables: a fresh assign() must give
+// the minimum-cost assignment, found here by a bitmask search over the
+// targets, and moveBox() after a push must agree with a fresh assign() of
+// the new boxes. Runs with as many, fewer and more boxes than targets.
+
+static const int CASES = 200000;
+
+// Fewest total pushes over every way to give each box its own target.
+static int bruteForceCost(const std::vector<uint16_t>& table, int columns, int floorCount,
+                          const std::vector<int>& boxes) {
+    if ((int)boxes.size() > columns) {
+        return BoxMatching::INFINITE_COST;
+    }
+    std::vector<int> best(1 << columns, INT_MAX);
+    best[0] = 0;
+    int result = INT_MAX;
+    for (int mask = 0; mask < (1 << columns); mask++) {
+        if (best[mask] == INT_MAX) {
+            continue;
+        }
+        int row = __builtin_popcount(mask);
+        if (row == (int)boxes.size()) {
+            result = std::min(result, best[mask]);
+            continue;
+        }
+        for (int col = 0; col < columns; col++) {
+            if (mask & (1 << col)) {
+                continue;
+            }
+            uint16_t distance = table[col * floorCount + boxes[row]];
+            int cost = distance == SolverContext::UNREACHABLE ? BoxMatching::INFINITE_COST : distance;
+            best[mask | (1 << col)] = std::min(best[mask | (1 << col)], best[mask] + cost);
+        }
+    }
+    return result;
+}
+
+int main() {
+    std::mt19937 random(12345);
+    int failures = 0;
+    int unequal = 0;
+    
+    for (int test = 0; test < CASES && failures < 10; test++) {
+        int floorCount = 4 + random() % 20;
+        int columns = 1 + random() % std::min(8, floorCount - 1);
+        int boxCount = 1 + random() % std::min(columns + 1, floorCount - 1);
+        
+        std::vector<uint16_t> table(columns * floorCount);
+        for (uint16_t& distance : table) {
+            distance = random() % 8 == 0 ? SolverContext::UNREACHABLE : random() % 12;
+        }
+        
+        std::vector<int> cells(floorCount);
+        for (int i = 0; i < floorCount; i++) {
+            cells[i] = i;
+        }
+        std::shuffle(cells.begin(), cells.end(), random);
+        BoxSet boxes;
+        for (int i = 0; i < boxCount; i++) {
+            boxes.set(cells[i]);
+        }
+        int from = cells[random() % boxCount];
+        int to = cells[boxCount + random() % (floorCount - boxCount)];
+        unequal += boxCount != columns;
+        
+        BoxMatching matching;
+        matching.assign(table, columns, floorCount, boxes);
+        std::vector<int> boxList;
+        for (int cell = boxes.next(0); cell >= 0; cell = boxes.next(cell + 1)) {
+            boxList.push_back(cell);
+        }
+        int expected = bruteForceCost(table, columns, floorCount, boxList);
+        if (std::min(matching.cost(), (int)BoxMatching::INFINITE_COST) != std::min(expected, (int)BoxMatching::INFINITE_COST)) {
+            std::cerr << "assign: cost " << matching.cost() << ", expected " << expected << " (" << boxCount
+                      << " boxes, " << columns << " targets)" << std::endl;
+            failures++;
+        }
+        
+        matching.moveBox(from, to);
+        boxes.reset(from);
+        boxes.set(to);
+        BoxMatching fresh;
+        fresh.assign(table, columns, floorCount, boxes);
+        if (std::min(matching.cost(), (int)BoxMatching::INFINITE_COST) != std::min(fresh.cost(), (int)BoxMatching::INFINITE_COST)) {
+            std::cerr << "moveBox: cost " << matching.cost() << ", fresh assign " << fresh.cost() << " ("
+                      << boxCount << " boxes, " << columns << " targets)" << std::endl;
+            failures++;
+        }
+    }
+    
+    if (failures > 0) {
+        std::cerr << "box_matching_test: FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "box_matching_test: " << CASES << " cases passed, " << unequal << " with unequal counts" << std::endl;
+    return 0;
+}